@@ -8,6 +8,7 @@
 #include <ajg/synth/support.hpp>
 #include <ajg/synth/adapters/ref.hpp>
 #include <ajg/synth/adapters/bool.hpp>
+#include <ajg/synth/adapters/json.hpp>
 #include <ajg/synth/adapters/none.hpp>
 #include <ajg/synth/adapters/array.hpp>
 #include <ajg/synth/adapters/ptime.hpp>
@@ -0,0 +1,220 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_ADAPTERS_JSON_HPP_INCLUDED
+#define AJG_SYNTH_ADAPTERS_JSON_HPP_INCLUDED
+
+#include <map>
+#include <string>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+
+#include <boost/none.hpp>
+
+#include <ajg/synth/detail/json.hpp>
+#include <ajg/synth/adapters/pair.hpp>
+#include <ajg/synth/adapters/concrete_adapter.hpp>
+
+namespace ajg {
+namespace synth {
+namespace adapters {
+
+//
+// specialization for detail::json_value
+//     Arrays, objects and numbers are adapted as such; other scalars are converted to native values
+//     as they are accessed. Numbers are output as written and only converted for arithmetic and
+//     comparison. Attributes that are set (e.g. by loops, when the value is a context's data) are
+//     kept in an overlay on top of the (immutable) document.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <class Value>
+struct adapter<Value, detail::json_value>     : concrete_adapter<Value, detail::json_value, type_flags(container | sequential | associative)> {
+    adapter(detail::json_value const& adapted) : concrete_adapter<Value, detail::json_value, type_flags(container | sequential | associative)>(adapted) {}
+
+    AJG_SYNTH_ADAPTER_TYPEDEFS(Value);
+
+  private:
+
+    typedef detail::json_document                                               document_type;
+    typedef std::map<string_type, attribute_type>                               overlay_type;
+
+  public:
+
+    virtual type_flags flags() const override {
+        switch (this->document().kind(this->index())) {
+        case document_type::integer_kind:  return type_flags(numeric | integral);
+        case document_type::floating_kind: return type_flags(numeric | floating);
+        case document_type::object_kind:   return type_flags(container | sequential | associative);
+        default:                           return type_flags(container | sequential);
+        }
+    }
+
+    virtual optional<boolean_type> get_boolean() const override {
+        if (optional<number_type> const n = this->get_number()) {
+            return *n != 0;
+        }
+        return this->document().size(this->index()) != 0 || !this->overlay_.empty();
+    }
+
+    virtual optional<number_type> get_number() const override {
+        switch (this->document().kind(this->index())) {
+        case document_type::integer_kind:  return number_type(this->document().integer(this->index()));
+        case document_type::floating_kind: return number_type(this->document().floating(this->index()));
+        default:                           return boost::none;
+        }
+    }
+
+    virtual optional<string_type> get_string() const override {
+        if (this->is_number()) {
+            return to_string(this->document(), this->index());
+        }
+        return boost::none;
+    }
+
+    virtual optional<range_type> get_range() const override {
+        if (this->is_number()) {
+            return boost::none;
+        }
+        document_type const& document = this->document();
+        bool          const  members  = document.kind(this->index()) == document_type::object_kind;
+        return range_type( const_json_iterator(document, document.first(this->index()), members)
+                         , const_json_iterator(document, document.last(this->index()),  members)
+                         );
+    }
+
+    virtual boolean_type equal_to(value_type const& that) const override {
+        if (this->is_number() && that.is_numeric()) {
+            return *this->get_number() == that.to_number();
+        }
+        return this->adapted() == that.template as<detail::json_value>();
+    }
+
+    virtual boolean_type less(value_type const& that) const override {
+        if (this->is_number() && that.is_numeric()) {
+            return *this->get_number() < that.to_number();
+        }
+        return this->adapted() < that.template as<detail::json_value>();
+    }
+
+    virtual attribute_type attribute(value_type const& key) const override {
+        string_type const k = key.to_string();
+
+        if (!this->overlay_.empty()) {
+            typename overlay_type::const_iterator const it = this->overlay_.find(k);
+            if (it != this->overlay_.end()) {
+                return it->second;
+            }
+        }
+
+        std::string const narrow(k.begin(), k.end());
+        if (std::size_t const i = this->document().find(this->index(), narrow.data(), narrow.size())) {
+            return to_value(this->document(), i);
+        }
+        return boost::none;
+    }
+
+    virtual void attribute(value_type const& key, attribute_type const& attribute) const override {
+        this->overlay_[key.to_string()] = attribute;
+    }
+
+    virtual attributes_type attributes() const override {
+        attributes_type attributes;
+        document_type const& document = this->document();
+
+        if (document.kind(this->index()) == document_type::object_kind) {
+            for (std::size_t k = document.first(this->index()); k != document.last(this->index()); k = document.next(document.next(k))) {
+                string_type const name = to_string(document, k);
+                if (this->overlay_.find(name) == this->overlay_.end()) {
+                    attributes.insert(value_type(name));
+                }
+            }
+        }
+
+        for (auto const& entry : this->overlay_) {
+            if (entry.second) {
+                attributes.insert(value_type(entry.first));
+            }
+        }
+
+        return attributes;
+    }
+
+    virtual boolean_type output(ostream_type& ostream) const override {
+        if (this->is_number()) {
+            document_type const& document = this->document();
+            char const* const chars = document.chars(this->index());
+            std::copy(chars, chars + document.size(this->index()), std::ostreambuf_iterator<char_type>(ostream));
+            return true;
+        }
+        value_type::delimited(ostream, *this->get_range());
+        return true;
+    }
+
+  public:
+
+    inline static value_type to_value(document_type const& document, std::size_t const i) {
+        switch (document.kind(i)) {
+        case document_type::null_kind:     return value_type(boost::none);
+        case document_type::boolean_kind:  return value_type(boolean_type(document.boolean(i)));
+        case document_type::string_kind:   return value_type(to_string(document, i));
+        default:                           return value_type(detail::json_value(&document, i));
+        }
+    }
+
+    inline static string_type to_string(document_type const& document, std::size_t const i) {
+        char const* const chars = document.chars(i);
+        return string_type(chars, chars + document.size(i));
+    }
+
+  private:
+
+    inline document_type const& document() const { return *this->adapted().document; }
+    inline std::size_t          index()    const { return this->adapted().index; }
+
+    inline bool is_number() const {
+        document_type::kind_type const kind = this->document().kind(this->index());
+        return kind == document_type::integer_kind || kind == document_type::floating_kind;
+    }
+
+    // Iterates over an array's elements or an object's members (as key/value pairs.)
+    struct const_json_iterator {
+      public:
+
+        const_json_iterator(document_type const& document, std::size_t const i, bool const members)
+            : document_(&document), i_(i), members_(members) {}
+
+        inline const_json_iterator operator ++(int) {
+            const_json_iterator const previous = *this;
+            this->i_ = this->document_->next(this->members_ ? this->document_->next(this->i_) : this->i_);
+            return previous;
+        }
+
+        inline value_type operator *() const {
+            if (this->members_) {
+                std::size_t const v = this->document_->next(this->i_);
+                return value_type(std::make_pair(to_value(*this->document_, this->i_), to_value(*this->document_, v)));
+            }
+            return to_value(*this->document_, this->i_);
+        }
+
+        inline bool operator ==(const_json_iterator const& that) const {
+            return this->i_ == that.i_ && this->document_ == that.document_;
+        }
+
+      private:
+
+        document_type const* document_;
+        std::size_t          i_;
+        bool                 members_;
+    };
+
+  private:
+
+    mutable overlay_type overlay_;
+};
+
+}}} // namespace ajg::synth::adapters
+
+#endif // AJG_SYNTH_ADAPTERS_JSON_HPP_INCLUDED
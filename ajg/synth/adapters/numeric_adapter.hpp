@@ -23,7 +23,23 @@ template <class Value, class Adapted, type_flags Flags>
 struct numeric_adapter                      : concrete_adapter<Value, Adapted, type_flags(Flags | numeric | (boost::is_integral<Adapted>::value ? integral : 0) | (boost::is_floating_point<Adapted>::value ? floating : 0))> {
     numeric_adapter(Adapted const& adapted) : concrete_adapter<Value, Adapted, type_flags(Flags | numeric | (boost::is_integral<Adapted>::value ? integral : 0) | (boost::is_floating_point<Adapted>::value ? floating : 0))>(adapted) {}
 
-    virtual optional<typename Value::number_type> get_number() const { return static_cast<typename Value::number_type>(this->adapted()); }
+    AJG_SYNTH_ADAPTER_TYPEDEFS(Value);
+
+  public:
+
+    virtual optional<number_type> get_number() const { return static_cast<number_type>(this->adapted()); }
+
+    // Characters are left to the stream; everything else is formatted directly (see traits_type::format_number.)
+
+    virtual optional<string_type> get_string() const {
+        if (Flags & character) return boost::none;
+        return traits_type::format_number(this->adapted());
+    }
+
+    virtual boolean_type output(ostream_type& ostream) const {
+        if (Flags & character) return numeric_adapter::concrete_adapter::output(ostream);
+        return traits_type::output_number(ostream, this->adapted()), true;
+    }
 };
 
 }}} // namespace ajg::synth::adapters
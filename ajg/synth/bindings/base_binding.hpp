@@ -111,7 +111,10 @@ struct base_binding : boost::noncopyable {
 
   protected:
 
-    void render_to_stream(ostream_type& ostream, foreign_type& data) const {
+    // NOTE: Takes any adaptable data, not just foreign_type, so that callers may pass native
+    //       representations (e.g. a detail::json_value) directly.
+    template <class Data>
+    void render_to_stream(ostream_type& ostream, Data const& data) const {
              if (template0_) return template0_->render_to_stream(ostream, data);
         else if (template1_) return template1_->render_to_stream(ostream, data);
         else if (template2_) return template2_->render_to_stream(ostream, data);
@@ -120,6 +123,16 @@ struct base_binding : boost::noncopyable {
         else AJG_SYNTH_THROW(std::logic_error("missing template"));
     }
 
+    template <class Data>
+    void render_to_stream(ostream_type& ostream, Data const& data, paths_type& dependencies) const {
+             if (template0_) return template0_->render_to_stream(ostream, data, dependencies);
+        else if (template1_) return template1_->render_to_stream(ostream, data, dependencies);
+        else if (template2_) return template2_->render_to_stream(ostream, data, dependencies);
+        else if (template3_) return template3_->render_to_stream(ostream, data, dependencies);
+        else if (template4_) return template4_->render_to_stream(ostream, data, dependencies);
+        else AJG_SYNTH_THROW(std::logic_error("missing template"));
+    }
+
     string_type render_to_string(foreign_type& data) const {
              if (template0_) return template0_->render_to_string(data);
         else if (template1_) return template1_->render_to_string(data);
@@ -129,6 +142,15 @@ struct base_binding : boost::noncopyable {
         else AJG_SYNTH_THROW(std::logic_error("missing template"));
     }
 
+    void render_to_buffer(string_type& buffer, foreign_type& data) const {
+             if (template0_) return template0_->render_to_buffer(buffer, data);
+        else if (template1_) return template1_->render_to_buffer(buffer, data);
+        else if (template2_) return template2_->render_to_buffer(buffer, data);
+        else if (template3_) return template3_->render_to_buffer(buffer, data);
+        else if (template4_) return template4_->render_to_buffer(buffer, data);
+        else AJG_SYNTH_THROW(std::logic_error("missing template"));
+    }
+
     void render_to_path(string_type const& path, foreign_type& data) const {
              if (template0_) return template0_->render_to_path(path, data);
         else if (template1_) return template1_->render_to_path(path, data);
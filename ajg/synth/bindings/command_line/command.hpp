@@ -8,19 +8,33 @@
 #include <ajg/synth/support.hpp>
 
 #include <string>
+#include <cerrno>
+#include <cstdio>
+#include <thread>
 #include <vector>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <sstream>
 #include <iostream>
+#include <iterator>
 
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 #include <boost/property_tree/xml_parser.hpp>
-#include <boost/property_tree/json_parser.hpp>
 
 #include <external/other/optionparser.h>
 
 #include <ajg/synth/cache.hpp>
+#include <ajg/synth/metrics.hpp>
 #include <ajg/synth/exceptions.hpp>
+#include <ajg/synth/detail/json.hpp>
 #include <ajg/synth/detail/text.hpp>
+#include <ajg/synth/adapters/json.hpp>
+#include <ajg/synth/detail/file_cache.hpp>
+#include <ajg/synth/bindings/command_line/server.hpp>
+#include <ajg/synth/bindings/command_line/manifest.hpp>
 
 namespace ajg {
 namespace synth {
@@ -34,6 +48,12 @@ enum command_options
     , context_option
     , engine_option
     , directory_option
+    , input_option
+    , output_option
+    , manifest_option
+    , serve_option
+    , connect_option
+    , metrics_option
     };
 
 template <class Binding>
@@ -74,9 +94,14 @@ struct command {
             , {context_option,     0, "c", "context",     param_required, "  -c file, --context=file      contextual data             *.{ini,json,xml}"}
             , {engine_option,      0, "e", "engine",      param_required, "  -e name, --engine=name       template engine             {django,ssi,tmpl}"}
             , {directory_option,   0, "d", "directory",   param_required, "  -d path, --directory=path    template location(s)        (default: '.')"}
+            , {input_option,       0, "i", "input",       param_required, "  -i file, --input=file        template to render          (default: stdin)"}
+            , {output_option,      0, "o", "output",      param_required, "  -o file, --output=file       where to render it          (default: stdout)"}
+            , {manifest_option,    0, "m", "manifest",    param_required, "  -m dir,  --manifest=dir      skip unchanged outputs      (requires -i and -o)"}
+            , {serve_option,       0, "",  "serve",       param_required, "           --serve=socket      render requests sent to     socket (daemon mode)"}
+            , {connect_option,     0, "",  "connect",     param_required, "           --connect=socket    have a daemon render at     socket"}
+            , {unknown_option,     0, "",  "",            param_allowed,  "                               (default: $SYNTH_SOCKET)"}
+            , {metrics_option,     0, "",  "metrics",     param_attached, "           --metrics=format    print counters & latencies  {prometheus,json}"}
             , {unknown_option,     0, "",  "",            param_allowed,  "\n"}
-            // ("input,i",       ("file", string),  "the source (default: '-')")            // TODO
-            // ("output,o",      ("file", string),  "the destination (default: '-')")       // TODO
             // ("source,s",      ("text", string),  "inline alternative to input file")     // TODO
             // ("?,?",           ("name", string),  "the context's format: {ini,json,xml}") // TODO
             // TODO: formats
@@ -125,50 +150,183 @@ struct command {
                    << std::endl;
             return;
         }
+        else if (opts[serve_option]) {
+            std::string const path = opts[serve_option].last()->arg;
+            server<command> daemon(path, std::thread::hardware_concurrency());
+            daemon.run();
+            return;
+        }
+        else if (opts[metrics_option]) {
+            option_type const* const option = opts[metrics_option].last();
+            char const* const socket = opts[connect_option] ? opts[connect_option].last()->arg : std::getenv("SYNTH_SOCKET");
+            request r;
+            r.metrics = option->arg ? option->arg : "prometheus";
+            paths_type dependencies;
+
+            // A daemon's metrics are what's interesting, since this process hasn't done anything yet.
+            if (socket == 0 || *socket == 0 || !forward_request(socket, r, output, dependencies)) {
+                if (opts[connect_option]) {
+                    AJG_SYNTH_THROW(socket_error("connect to", socket));
+                }
+                output << metrics::dump(r.metrics) << std::flush;
+            }
+            return;
+        }
         else if (!opts[engine_option]) {
             ::option::printUsage(error, descriptors);
             AJG_SYNTH_THROW(missing_option("engine"));
         }
 
+        std::string const context       = opts[context_option]  ? opts[context_option].last()->arg  : "";
+        std::string const source        = opts[input_option]    ? opts[input_option].last()->arg    : "";
+        std::string const target        = opts[output_option]   ? opts[output_option].last()->arg   : "";
+        std::string const manifest_path = opts[manifest_option] ? opts[manifest_option].last()->arg : "";
+        string_type const engine        = to_string(opts[engine_option].last());
+
         paths_type directories;
         for (option_type* option = opts[directory_option]; option; option = option->next()) {
             directories.push_back(to_string(option));
         }
 
-        options_type options;
-        // TODO: options.metadata.
-        options.debug       = false; // TODO: Turn into a flag.
-        options.directories = directories;
-        options.caching     = caching_none;
+        if (!manifest_path.empty()) {
+            if (source.empty()) AJG_SYNTH_THROW(missing_option("input"));
+            if (target.empty()) AJG_SYNTH_THROW(missing_option("output"));
+        }
 
-        string_type  const engine = to_string(opts[engine_option].last());
-        binding_type const binding(input >> std::noskipws, engine, options);
+        // With a manifest, outputs whose inputs haven't changed since they were last built are kept.
+        manifest const m(manifest_path);
+        manifest::digest_type digest = manifest::digest_type();
+        if (!manifest_path.empty()) { // Digesting reads every input in full, so only when needed.
+            digest = digest_inputs(engine, directories, source, context);
+            if (m.fresh(target, digest)) {
+                return;
+            }
+        }
 
-        ptree_type ptree;
-        if (opts[context_option]) {
-            if (option_type const* const option = opts[context_option].last()) {
-                std::string const narrow_path = option->arg;
-                std::basic_ifstream<char_type> file;
+        std::basic_ifstream<char_type> source_file;
+        if (!source.empty()) {
+            source_file.open(source.c_str(), std::ios::binary);
+            if (!source_file) {
+                AJG_SYNTH_THROW(read_error(source, std::strerror(errno)));
+            }
+        }
 
-                try {
-                    file.open(narrow_path.c_str(), std::ios::binary);
-                }
-                catch (std::exception const& e) {
-                    AJG_SYNTH_THROW(read_error(narrow_path, e.what()));
+        // Outputs are rendered to the side and moved into place only once complete.
+        boost::scoped_ptr<temporary_file> temporary;
+        std::basic_ofstream<char_type> target_file;
+        if (!target.empty()) {
+            temporary.reset(new temporary_file(target));
+            target_file.open(temporary->name().c_str(), std::ios::binary | std::ios::trunc);
+            if (!target_file) {
+                AJG_SYNTH_THROW(write_error(temporary->name(), std::strerror(errno)));
+            }
+        }
+
+        istream_type& in  = source.empty() ? input  : source_file;
+        ostream_type& out = target.empty() ? output : target_file;
+        paths_type dependencies;
+
+        // Try handing the rendering off to a daemon, if there's one; when the socket merely comes
+        // from the environment and nobody's listening on it, quietly fall back to rendering here.
+        char const* const socket = opts[connect_option] ? opts[connect_option].last()->arg : std::getenv("SYNTH_SOCKET");
+        if (socket != 0 && *socket != 0) {
+            request r;
+            r.working_directory = detail::get_current_working_directory();
+            r.engine            = text::narrow(engine);
+            r.context           = context;
+            r.source.assign(std::istreambuf_iterator<char_type>(in), std::istreambuf_iterator<char_type>());
+
+            for (auto const& directory : directories) {
+                r.directories.push_back(text::narrow(directory));
+            }
+
+            if (!forward_request(socket, r, out, dependencies)) {
+                if (opts[connect_option]) {
+                    AJG_SYNTH_THROW(socket_error("connect to", socket));
                 }
 
-                     if (text::ends_with(narrow_path, ".ini"))  boost::property_tree::read_ini(file, ptree);
-                else if (text::ends_with(narrow_path, ".json")) boost::property_tree::read_json(file, ptree);
-                else if (text::ends_with(narrow_path, ".xml"))  boost::property_tree::read_xml(file, ptree);
-                else AJG_SYNTH_THROW(invalid_parameter(name_of(*option)));
+                std::istringstream stream(r.source);
+                render(binding_type(stream >> std::noskipws, engine, make_options(directories)), context, out, dependencies);
+            }
+        }
+        else {
+            render(binding_type(in >> std::noskipws, engine, make_options(directories)), context, out, dependencies);
+        }
+
+        if (!target.empty()) {
+            target_file.close();
+            if (!target_file) {
+                AJG_SYNTH_THROW(write_error(temporary->name(), std::strerror(errno)));
             }
+            temporary->move();
         }
 
-        binding.render_to_stream(output, ptree);
+        if (!manifest_path.empty()) {
+            dependencies.push_back(text::widen(source));
+            m.update(target, digest, dependencies);
+        }
+    }
+
+    // Renders a binding using the contextual data found at path, if any, noting the files it reads.
+    static void render(binding_type const& binding, std::string const& path, ostream_type& output, paths_type& dependencies) {
+        if (path.empty()) {
+            binding.render_to_stream(output, ptree_type(), dependencies);
+        }
+        // JSON is parsed natively (and in place, mapped if large) since it's by far the most common format.
+        else if (text::ends_with(path, ".json")) {
+            boost::shared_ptr<detail::file_contents const> const contents(new detail::file_contents(path, true));
+            detail::json_document const document(contents);
+            binding.render_to_stream(output, detail::json_value(&document, 0), dependencies);
+        }
+        else {
+            std::basic_ifstream<char_type> file;
+            ptree_type ptree;
+
+            try {
+                file.open(path.c_str(), std::ios::binary);
+            }
+            catch (std::exception const& e) {
+                AJG_SYNTH_THROW(read_error(path, e.what()));
+            }
+
+                 if (text::ends_with(path, ".ini")) boost::property_tree::read_ini(file, ptree);
+            else if (text::ends_with(path, ".xml")) boost::property_tree::read_xml(file, ptree);
+            else AJG_SYNTH_THROW(invalid_parameter("context"));
+
+            binding.render_to_stream(output, ptree, dependencies);
+        }
+    }
+
+    // The options templates are parsed with; one-off invocations gain nothing from caching.
+    inline static options_type make_options(paths_type const& directories, caching_mask const caching = caching_none) {
+        options_type options;
+        // TODO: options.metadata.
+        options.debug       = false; // TODO: Turn into a flag.
+        options.directories = directories;
+        options.caching     = caching;
+        return options;
     }
 
   private:
 
+    // Digests everything an output depends on besides the files read while rendering it.
+    inline static manifest::digest_type digest_inputs( string_type const& engine
+                                                     , paths_type  const& directories
+                                                     , std::string const& source
+                                                     , std::string const& context
+                                                     ) {
+        std::string key = AJG_SYNTH_VERSION_STRING;
+        key += '\0' + text::narrow(engine);
+        for (auto const& directory : directories) {
+            key += '\0' + text::narrow(directory);
+        }
+        key += '\0' + source + '\0' + context;
+
+        manifest::digest_type const digest = detail::digest_bytes(key.data(), key.size());
+        manifest::digest_type const data   = context.empty() ? 0 : manifest::digest_file(context);
+        return detail::digest_bytes(reinterpret_cast<char const*>(&data), sizeof(data), digest);
+    }
+
     inline static string_type to_string(option_type const* option) {
         if (option == 0 || option->arg == 0) return string_type();
         else return text::widen(std::string(option->arg));
@@ -201,6 +359,13 @@ struct command {
         else return ::option::ARG_OK;
     }
 
+    // Like param_allowed, but only when given as --name=value, so that the next argument isn't taken.
+    static status_type param_attached(option_type const& option, bool const) {
+             if (option.arg == 0 || option.name[option.namelen] == 0) return ::option::ARG_IGNORE;
+        else if (option.arg[0] == 0) AJG_SYNTH_THROW(empty_parameter(name_of(option)));
+        else return ::option::ARG_OK;
+    }
+
     static status_type param_required(option_type const& option, bool const) {
              if (option.arg == 0)    AJG_SYNTH_THROW(missing_parameter(name_of(option)));
         else if (option.arg[0] == 0) AJG_SYNTH_THROW(empty_parameter(name_of(option)));
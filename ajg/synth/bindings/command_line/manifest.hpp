@@ -0,0 +1,232 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_BINDINGS_COMMAND_LINE_MANIFEST_HPP_INCLUDED
+#define AJG_SYNTH_BINDINGS_COMMAND_LINE_MANIFEST_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <map>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <sys/stat.h>
+
+#if AJG_SYNTH_IS_PLATFORM_WINDOWS
+#    include <direct.h>
+#else
+#    include <fcntl.h>
+#    include <unistd.h>
+#endif
+
+#include <boost/noncopyable.hpp>
+
+#include <ajg/synth/exceptions.hpp>
+#include <ajg/synth/detail/file_cache.hpp>
+#include <ajg/synth/detail/digest_streambuf.hpp>
+
+namespace ajg {
+namespace synth {
+namespace bindings {
+namespace command_line {
+
+//
+// temporary_file:
+//     A uniquely named file next to path, to be written and then moved onto path atomically once
+//     complete; unless it's been moved, it's removed when it goes out of scope (e.g. on failure.)
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct temporary_file : boost::noncopyable {
+  public:
+
+    explicit temporary_file(std::string const& path) : path_(path), moved_(false) {
+    #if AJG_SYNTH_IS_PLATFORM_WINDOWS
+        // TODO: Use GetTempFileName or _O_EXCL.
+        this->name_ = path + ".tmp";
+    #else
+        static std::atomic<unsigned> counter(0);
+
+        for (;;) { // NOTE: Unlike mkstemp's, these files are created with the usual permissions.
+            std::ostringstream name;
+            name << path << '.' << ::getpid() << '.' << counter++ << ".tmp";
+            this->name_ = name.str();
+
+            int const fd = ::open(this->name_.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+            if (fd >= 0) {
+                ::close(fd);
+                break;
+            }
+            else if (errno != EEXIST) {
+                AJG_SYNTH_THROW(write_error(this->name_, std::strerror(errno)));
+            }
+        }
+    #endif
+    }
+
+    ~temporary_file() {
+        if (!this->moved_) {
+            std::remove(this->name_.c_str());
+        }
+    }
+
+  public:
+
+    inline std::string const& name() const { return this->name_; }
+
+    void move() {
+        if (std::rename(this->name_.c_str(), this->path_.c_str()) != 0) {
+            AJG_SYNTH_THROW(write_error(this->path_, std::strerror(errno)));
+        }
+        this->moved_ = true;
+    }
+
+  private:
+
+    std::string const path_;
+    std::string       name_;
+    bool              moved_;
+};
+
+//
+// manifest:
+//     Remembers, for each output built, a digest of what it was built from (engine, directories,
+//     template and context) along with the files it read while rendering and a digest of each, so
+//     that outputs whose inputs are unchanged can be skipped. The manifest is a directory with one
+//     record per output, so that each build only reads and replaces its own, however many outputs
+//     there are; a record is a text file with a line for the output, followed by one tab-indented
+//     line per dependency, and it's replaced atomically.
+//     NOTE: Anything else an output depends on (e.g. commands run or the current time) is ignored.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct manifest : boost::noncopyable {
+  public:
+
+    typedef std::size_t                                                         digest_type;
+    typedef std::map<std::string, digest_type>                                  dependencies_type;
+    typedef std::pair<digest_type, dependencies_type>                           entry_type;
+
+  public:
+
+    explicit manifest(std::string const& path) : path_(path) {}
+
+  public:
+
+    // Whether output exists and was built from the same inputs as described by digest.
+    bool fresh(std::string const& output, digest_type const digest) const {
+        if (!exists(output)) {
+            return false;
+        }
+
+        entry_type entry;
+        if (!this->load(output, entry) || entry.first != digest) {
+            return false;
+        }
+
+        for (auto const& dependency : entry.second) {
+            if (digest_file(dependency.first) != dependency.second) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <class Paths>
+    void update(std::string const& output, digest_type const digest, Paths const& dependencies) const {
+        entry_type entry(digest, dependencies_type());
+        for (auto const& dependency : dependencies) {
+            std::string const path(dependency.begin(), dependency.end());
+            entry.second[path] = digest_file(path);
+        }
+        this->save(output, entry);
+    }
+
+    // Digests a file's contents; missing or unreadable files all get the same (unlikely) digest.
+    inline static digest_type digest_file(std::string const& path) {
+        try {
+            detail::file_contents const contents(path);
+            return detail::digest_bytes(contents.data(), contents.size());
+        }
+        catch (std::exception const&) {
+            return 0;
+        }
+    }
+
+  private:
+
+    inline static bool exists(std::string const& path) {
+        struct stat stats;
+        return ::stat(path.c_str(), &stats) == 0;
+    }
+
+    // Where output's record is kept, named after (a digest of) the output's path.
+    std::string record(std::string const& output) const {
+        std::ostringstream name;
+        name << this->path_ << '/' << std::hex << detail::digest_bytes(output.data(), output.size()) << ".deps";
+        return name.str();
+    }
+
+    bool load(std::string const& output, entry_type& entry) const {
+        std::ifstream file(this->record(output).c_str(), std::ios::binary);
+        std::string line;
+
+        // The first line names the output, in case another's record happens to have the same name.
+        if (!std::getline(file, line) || line.compare(0, output.size(), output) != 0
+                                      || line.size() <= output.size() || line[output.size()] != '\t') {
+            return false;
+        }
+        std::istringstream(line.substr(output.size() + 1)) >> std::hex >> entry.first;
+
+        while (std::getline(file, line)) {
+            std::string::size_type const tab = line.rfind('\t');
+            if (line.empty() || line[0] != '\t' || tab == 0) {
+                return false; // Malformed records are ignored; at worst, the output gets rebuilt.
+            }
+
+            digest_type digest = 0;
+            std::istringstream(line.substr(tab + 1)) >> std::hex >> digest;
+            entry.second[line.substr(1, tab - 1)] = digest;
+        }
+        return true;
+    }
+
+    void save(std::string const& output, entry_type const& entry) const {
+    #if AJG_SYNTH_IS_PLATFORM_WINDOWS
+        int const made = ::_mkdir(this->path_.c_str());
+    #else
+        int const made = ::mkdir(this->path_.c_str(), 0777);
+    #endif
+        if (made != 0 && errno != EEXIST) {
+            AJG_SYNTH_THROW(write_error(this->path_, std::strerror(errno)));
+        }
+
+        temporary_file temporary(this->record(output));
+        {
+            std::ofstream file(temporary.name().c_str(), std::ios::binary | std::ios::trunc);
+            file << std::hex << output << '\t' << entry.first << '\n';
+
+            for (auto const& dependency : entry.second) {
+                file << '\t' << dependency.first << '\t' << dependency.second << '\n';
+            }
+
+            if (!file.flush()) {
+                AJG_SYNTH_THROW(write_error(temporary.name(), std::strerror(errno)));
+            }
+        }
+        temporary.move();
+    }
+
+  private:
+
+    std::string const path_;
+};
+
+}}}} // namespace ajg::synth::bindings::command_line
+
+#endif // AJG_SYNTH_BINDINGS_COMMAND_LINE_MANIFEST_HPP_INCLUDED
@@ -0,0 +1,685 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_BINDINGS_COMMAND_LINE_SERVER_HPP_INCLUDED
+#define AJG_SYNTH_BINDINGS_COMMAND_LINE_SERVER_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <ostream>
+#include <utility>
+#include <iostream>
+#include <stdexcept>
+#include <streambuf>
+#include <condition_variable>
+
+#if !AJG_SYNTH_IS_PLATFORM_WINDOWS
+#    include <thread>
+#    include <poll.h>
+#    include <fcntl.h>
+#    include <signal.h>
+#    include <unistd.h>
+#    include <sys/un.h>
+#    include <sys/socket.h>
+#endif
+
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <ajg/synth/cache.hpp>
+#include <ajg/synth/metrics.hpp>
+#include <ajg/synth/exceptions.hpp>
+#include <ajg/synth/detail/text.hpp>
+#include <ajg/synth/detail/filesystem.hpp>
+
+namespace ajg {
+namespace synth {
+namespace bindings {
+namespace command_line {
+
+//
+// socket_error
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct socket_error : public std::runtime_error {
+    socket_error(std::string const& action, std::string const& path)
+        : std::runtime_error("could not " + action + " socket `" + path + "` (" + std::strerror(errno) + ")") {}
+};
+
+//
+// connection:
+//     One end of a (Unix domain) socket, over which tagged, length-prefixed frames are exchanged.
+//     Each frame is a one-byte tag, a four-byte big-endian length and that many bytes of payload.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct connection : boost::noncopyable {
+  public:
+
+    static std::size_t const max_frame_size = 256 * 1024 * 1024;
+
+  public:
+
+    explicit connection(int const fd) : fd_(fd) , bounded_(false) {}
+
+  #if AJG_SYNTH_IS_PLATFORM_WINDOWS
+
+    ~connection() {}
+
+    inline static int connect(std::string const& path) {
+        AJG_SYNTH_THROW(not_implemented("connecting to a socket on this platform"));
+    }
+
+    inline void write_frame(char const tag, char const* const data, std::size_t const size) {
+        AJG_SYNTH_THROW(not_implemented("writing to a socket on this platform"));
+    }
+
+    inline bool read_frame(char& tag, std::string& data) {
+        AJG_SYNTH_THROW(not_implemented("reading from a socket on this platform"));
+    }
+
+  #else
+
+    ~connection() {
+        if (this->fd_ >= 0) {
+            ::close(this->fd_);
+        }
+    }
+
+    // Returns a connected descriptor, or -1 if nobody's listening at the given path.
+    inline static int connect(std::string const& path) {
+        struct sockaddr_un const address = make_address(path);
+        int const fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            AJG_SYNTH_THROW(socket_error("open", path));
+        }
+        if (::connect(fd, reinterpret_cast<struct sockaddr const*>(&address), sizeof(address)) != 0) {
+            int const error = errno; // E.g. ECONNREFUSED, if the socket was left behind.
+            ::close(fd);
+            errno = error;
+            return -1;
+        }
+        return fd;
+    }
+
+    // Bounds how long reads may wait from now on, in total, after which they fail.
+    inline void deadline(std::chrono::steady_clock::time_point const deadline) {
+        this->deadline_ = deadline;
+        this->bounded_  = true;
+    }
+
+    inline static struct sockaddr_un make_address(std::string const& path) {
+        struct sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            AJG_SYNTH_THROW(std::invalid_argument("socket path: " + path));
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.data(), path.size());
+        return address;
+    }
+
+    inline void write_frame(char const tag, char const* const data, std::size_t const size) {
+        unsigned char const header[5] =
+            { static_cast<unsigned char>(tag)
+            , static_cast<unsigned char>(size >> 24), static_cast<unsigned char>(size >> 16)
+            , static_cast<unsigned char>(size >> 8),  static_cast<unsigned char>(size)
+            };
+        this->write_all(reinterpret_cast<char const*>(header), sizeof(header));
+        this->write_all(data, size);
+    }
+
+    // Returns false if the other end hung up cleanly (i.e. between frames.)
+    inline bool read_frame(char& tag, std::string& data) {
+        unsigned char header[5];
+        if (!this->read_all(reinterpret_cast<char*>(header), sizeof(header), true)) {
+            return false;
+        }
+
+        std::size_t const size = (std::size_t(header[1]) << 24) | (std::size_t(header[2]) << 16)
+                               | (std::size_t(header[3]) << 8)  |  std::size_t(header[4]);
+        if (size > max_frame_size) {
+            AJG_SYNTH_THROW(std::runtime_error("oversized frame"));
+        }
+
+        tag = static_cast<char>(header[0]);
+        data.resize(size);
+        if (size != 0) {
+            this->read_all(&data[0], size, false);
+        }
+        return true;
+    }
+
+  private:
+
+    inline void write_all(char const* data, std::size_t size) {
+        while (size != 0) {
+            ssize_t const n = ::write(this->fd_, data, size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            else if (n <= 0) {
+                AJG_SYNTH_THROW(socket_error("write to", ""));
+            }
+            data += n;
+            size -= static_cast<std::size_t>(n);
+        }
+    }
+
+    inline bool read_all(char* data, std::size_t size, bool const eof_allowed) {
+        for (bool first = true; size != 0; first = false) {
+            if (this->bounded_) {
+                this->await();
+            }
+            ssize_t const n = ::read(this->fd_, data, size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            else if (n == 0 && first && eof_allowed) {
+                return false;
+            }
+            else if (n <= 0) {
+                AJG_SYNTH_THROW(std::runtime_error("truncated frame"));
+            }
+            data += n;
+            size -= static_cast<std::size_t>(n);
+        }
+        return true;
+    }
+
+    inline void await() const {
+        for (;;) {
+            std::chrono::steady_clock::duration const remaining = this->deadline_ - std::chrono::steady_clock::now();
+            int const milliseconds = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count());
+            struct pollfd readable = { this->fd_, POLLIN, 0 };
+
+            int const n = milliseconds <= 0 ? 0 : ::poll(&readable, 1, milliseconds);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            else if (n == 0) {
+                AJG_SYNTH_THROW(std::runtime_error("timed out"));
+            }
+            return; // Readable, hung up or failed; either way, read will tell.
+        }
+    }
+
+  #endif
+
+  private:
+
+    int const                             fd_;
+    bool                                  bounded_;
+    std::chrono::steady_clock::time_point deadline_;
+};
+
+//
+// frame_streambuf:
+//     Buffers whatever is written to it and sends it along as output frames, as it fills up.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct frame_streambuf : std::streambuf, boost::noncopyable {
+  public:
+
+    static char const tag = 'o';
+
+  public:
+
+    explicit frame_streambuf(connection& c) : connection_(c), buffer_(64 * 1024), sent_(0) {
+        this->setp(&this->buffer_[0], &this->buffer_[0] + this->buffer_.size());
+    }
+
+  protected:
+
+    virtual int_type overflow(int_type const c) {
+        this->sync();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *this->pptr() = traits_type::to_char_type(c);
+            this->pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual int sync() {
+        if (std::size_t const size = static_cast<std::size_t>(this->pptr() - this->pbase())) {
+            this->connection_.write_frame(tag, this->pbase(), size);
+            this->setp(&this->buffer_[0], &this->buffer_[0] + this->buffer_.size());
+            this->sent_ += size;
+        }
+        return 0;
+    }
+
+    // Only reports how much has been written (i.e. tellp), since frames can't be taken back.
+    virtual pos_type seekoff(off_type const off, std::ios_base::seekdir const dir, std::ios_base::openmode const which) {
+        if (off != 0 || dir != std::ios_base::cur || !(which & std::ios_base::out)) {
+            return pos_type(off_type(-1));
+        }
+        return pos_type(off_type(this->sent_ + static_cast<std::size_t>(this->pptr() - this->pbase())));
+    }
+
+  private:
+
+    connection&       connection_;
+    std::vector<char> buffer_;
+    std::size_t       sent_;
+};
+
+//
+// request:
+//     What a client asks a server to render; paths are relative to the client's working directory.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct request {
+  public:
+
+    std::string              working_directory;
+    std::string              engine;
+    std::string              context;
+    std::vector<std::string> directories;
+    std::string              source;
+    std::string              metrics; // A format; if given, the server reports its metrics instead.
+
+  public:
+
+    void send(connection& c) const {
+        c.write_frame('w', this->working_directory.data(), this->working_directory.size());
+        c.write_frame('e', this->engine.data(), this->engine.size());
+        c.write_frame('c', this->context.data(), this->context.size());
+        for (auto const& directory : this->directories) {
+            c.write_frame('d', directory.data(), directory.size());
+        }
+        c.write_frame('s', this->source.data(), this->source.size());
+        if (!this->metrics.empty()) {
+            c.write_frame('m', this->metrics.data(), this->metrics.size());
+        }
+        c.write_frame('.', 0, 0);
+    }
+
+    bool receive(connection& c) {
+        char tag;
+        std::string data;
+
+        while (c.read_frame(tag, data)) {
+            switch (tag) {
+            case 'w': this->working_directory.swap(data);  break;
+            case 'e': this->engine.swap(data);             break;
+            case 'c': this->context.swap(data);            break;
+            case 'd': this->directories.push_back(data);   break;
+            case 's': this->source.swap(data);             break;
+            case 'm': this->metrics.swap(data);            break;
+            case '.': return true;
+            default:  AJG_SYNTH_THROW(std::runtime_error("unknown request frame"));
+            }
+        }
+        return false;
+    }
+
+    // Anchors a (possibly relative) path the same way the client would have.
+    std::string resolve(std::string const& path) const {
+        return path.empty() || detail::is_absolute(path) ? path : this->working_directory + '/' + path;
+    }
+};
+
+//
+// forward_request:
+//     Client side: sends a request to the server listening at path, copies what it renders to the
+//     output and collects the files it read. Returns false, doing nothing, if nobody's listening.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <class OStream, class Paths>
+inline bool forward_request(std::string const& path, request const& r, OStream& output, Paths& dependencies) {
+    int const fd = connection::connect(path);
+    if (fd < 0) {
+        return false;
+    }
+
+    connection c(fd);
+    r.send(c);
+
+    char tag;
+    std::string data;
+
+    while (c.read_frame(tag, data)) {
+        switch (tag) {
+        case 'o': output.write(data.data(), data.size()); break;
+        case 'r': dependencies.push_back(typename Paths::value_type(data.begin(), data.end())); break;
+        case '!': output.flush(); AJG_SYNTH_THROW(std::runtime_error(data));
+        case '.': output.flush(); return true;
+        default:  AJG_SYNTH_THROW(std::runtime_error("unknown response frame"));
+        }
+    }
+    AJG_SYNTH_THROW(std::runtime_error("server hung up"));
+}
+
+//
+// server:
+//     Listens on a Unix domain socket and renders each request received on a pool of workers.
+//     Each worker keeps its own cache of parsed templates (keyed on engine, directories and
+//     source) so that repeated requests skip parsing altogether, as well as (per-thread) caches
+//     of the templates those include or extend; workers share nothing mutable. Connections are
+//     only handed to workers once they have something to say, so idle clients tie up none, and
+//     each request must arrive within a timeout.
+//     NOTE: Only template directories and the context's path are resolved relative to the client;
+//           anything else (e.g. commands run by ssi's exec) runs relative to the server.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <class Command>
+struct server : boost::noncopyable {
+  public:
+
+    typedef Command                                                             command_type;
+    typedef typename command_type::binding_type                                 binding_type;
+    typedef typename command_type::options_type                                 options_type;
+    typedef typename command_type::string_type                                  string_type;
+    typedef typename command_type::paths_type                                   paths_type;
+
+  private:
+
+    typedef detail::text<string_type>                                           text;
+
+    // Bindings keep a reference to their source stream, so the two are kept together.
+    struct entry_type : boost::noncopyable {
+        std::istringstream stream;
+        binding_type const binding;
+
+        entry_type(std::string const& source, string_type const& engine, options_type const& options)
+            : stream(source), binding(stream >> std::noskipws, engine, options) {}
+    };
+
+    typedef boost::shared_ptr<entry_type const>                                 cached_type;
+    typedef std::map<std::string, cached_type>                                  entries_type;
+
+    // Along with the cache's metrics, per engine, resolved as each is first requested.
+    struct series_type {
+        metrics::series hits, misses, entries;
+    };
+
+    struct cache_type {
+        entries_type                       entries;
+        std::map<std::string, series_type> series;
+    };
+
+  public:
+
+    static std::size_t const max_entries = 256;
+
+    // Seconds to send a request in, or to take output.
+    inline static int timeout() { return 10; }
+
+  public:
+
+    server(std::string const& path, std::size_t const workers) : path_(path), workers_(workers == 0 ? 1 : workers), fd_(-1), bound_(false) {}
+
+  #if AJG_SYNTH_IS_PLATFORM_WINDOWS
+
+    void run() {
+        AJG_SYNTH_THROW(not_implemented("serving on this platform"));
+    }
+
+  #else
+
+    ~server() {
+        if (this->fd_ >= 0) {
+            ::close(this->fd_);
+        }
+        if (this->bound_) {
+            ::unlink(this->path_.c_str());
+        }
+    }
+
+    void run() {
+        // Clients that go away mid-render should only cost us that render.
+        ::signal(SIGPIPE, SIG_IGN);
+
+        struct sockaddr_un const address = connection::make_address(this->path_);
+
+        // Only clear away a socket a previous server failed to clean up, never a live server's.
+        int const live = connection::connect(this->path_);
+        if (live >= 0) {
+            ::close(live);
+            errno = EADDRINUSE;
+            AJG_SYNTH_THROW(socket_error("bind", this->path_));
+        }
+        else if (errno == ECONNREFUSED) {
+            ::unlink(this->path_.c_str());
+        }
+
+        if ((this->fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+            AJG_SYNTH_THROW(socket_error("open", this->path_));
+        }
+        if (::bind(this->fd_, reinterpret_cast<struct sockaddr const*>(&address), sizeof(address)) != 0) {
+            AJG_SYNTH_THROW(socket_error("bind", this->path_));
+        }
+        this->bound_ = true;
+        if (::listen(this->fd_, SOMAXCONN) != 0) {
+            AJG_SYNTH_THROW(socket_error("listen on", this->path_));
+        }
+        ::fcntl(this->fd_, F_SETFL, ::fcntl(this->fd_, F_GETFL) | O_NONBLOCK);
+
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < this->workers_; ++i) {
+            threads.push_back(std::thread(&server::work, this));
+        }
+        this->dispatch();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+  private:
+
+    typedef std::chrono::steady_clock                                           clock_type;
+    typedef std::pair<int, clock_type::time_point>                              pending_type;
+
+    // Accepts connections and holds on to them until they're readable (or the timeout elapses,
+    // in which case they're dropped) before queueing them up for the workers.
+    void dispatch() {
+        std::vector<pending_type>  pending;
+        std::vector<struct pollfd> fds;
+
+        for (;;) {
+            struct pollfd const listening = { this->fd_, POLLIN, 0 };
+            fds.assign(1, listening);
+            int wait = -1;
+
+            for (auto const& p : pending) {
+                struct pollfd const waiting = { p.first, POLLIN, 0 };
+                fds.push_back(waiting);
+                int const remaining = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(p.second - clock_type::now()).count());
+                if (wait < 0 || remaining < wait) {
+                    wait = remaining < 0 ? 0 : remaining;
+                }
+            }
+
+            if (::poll(&fds[0], static_cast<nfds_t>(fds.size()), wait) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                AJG_SYNTH_THROW(socket_error("poll on", this->path_));
+            }
+
+            clock_type::time_point const now = clock_type::now();
+            std::size_t waiting = 0;
+
+            for (std::size_t i = 0; i < pending.size(); ++i) {
+                     if (fds[i + 1].revents != 0)   this->enqueue(pending[i].first);
+                else if (now >= pending[i].second) ::close(pending[i].first);
+                else pending[waiting++] = pending[i];
+            }
+            pending.resize(waiting);
+
+            while (fds[0].revents & POLLIN) {
+                int const fd = ::accept(this->fd_, 0, 0);
+                if (fd < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) { // Accepted everyone waiting.
+                        break;
+                    }
+                    switch (errno) {
+                    case EINTR: case ECONNABORTED: continue;
+                    case EMFILE: case ENFILE: case ENOBUFS: case ENOMEM: // Wait for resources to free up.
+                        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                        break;
+                    default: AJG_SYNTH_THROW(socket_error("accept on", this->path_));
+                    }
+                    break;
+                }
+
+                // NOTE: Some platforms carry O_NONBLOCK over from the listening socket.
+                ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+                struct timeval const limit = { timeout(), 0 };
+                ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit));
+                pending.push_back(pending_type(fd, now + std::chrono::seconds(timeout())));
+            }
+        }
+    }
+
+    void enqueue(int const fd) {
+        {
+            std::lock_guard<std::mutex> const lock(this->mutex_);
+            this->connections_.push_back(fd);
+        }
+        this->ready_.notify_one();
+    }
+
+    int dequeue() {
+        std::unique_lock<std::mutex> lock(this->mutex_);
+        while (this->connections_.empty()) {
+            this->ready_.wait(lock);
+        }
+        int const fd = this->connections_.front();
+        this->connections_.pop_front();
+        return fd;
+    }
+
+    void work() {
+        cache_type cache;
+
+        for (;;) {
+            connection c(this->dequeue());
+            c.deadline(clock_type::now() + std::chrono::seconds(timeout()));
+            try {
+                request r;
+                if (r.receive(c)) {
+                    this->serve(c, r, cache);
+                }
+            }
+            catch (std::exception const& e) {
+                try { c.write_frame('!', e.what(), std::strlen(e.what())); } catch (...) {}
+            }
+        }
+    }
+
+  #endif
+
+    void serve(connection& c, request const& r, cache_type& cache) const {
+        if (!r.metrics.empty()) {
+            std::string const text = metrics::dump(r.metrics);
+            frame_streambuf buffer(c);
+            std::ostream output(&buffer);
+            output.exceptions(std::ios_base::badbit);
+            output.write(text.data(), text.size());
+            output.flush();
+            c.write_frame('.', 0, 0);
+            return;
+        }
+
+        paths_type directories;
+        for (auto const& directory : r.directories) {
+            directories.push_back(text::widen(r.resolve(directory)));
+        }
+        // Stands in for the client's current directory, where templates are looked for last.
+        directories.push_back(text::widen(r.working_directory));
+
+        // Workers are long-lived threads, so whatever templates they include or extend (and the
+        // files they read) are worth keeping around; the caches revalidate them, should they
+        // change. The request's own source is a stream, which is kept in `cache` instead.
+        caching_mask const caching = caching_mask(caching_paths | caching_files | caching_per_thread);
+        options_type const options = command_type::make_options(directories, caching);
+        cached_type const entry = this->get_or_parse(cache, r, options);
+
+        frame_streambuf buffer(c);
+        std::ostream output(&buffer);
+        paths_type dependencies;
+        output.exceptions(std::ios_base::badbit);
+        command_type::render(entry->binding, r.resolve(r.context), output, dependencies);
+        output.flush();
+
+        for (auto const& dependency : dependencies) {
+            std::string const narrow = text::narrow(dependency);
+            c.write_frame('r', narrow.data(), narrow.size());
+        }
+
+        c.write_frame('.', 0, 0);
+    }
+
+    cached_type get_or_parse(cache_type& cache, request const& r, options_type const& options) const {
+        std::string key = r.engine;
+        for (auto const& directory : options.directories) {
+            key += '\0' + text::narrow(directory);
+        }
+        key += '\0';
+        key += r.source;
+
+        typename std::map<std::string, series_type>::iterator s = cache.series.find(r.engine);
+        if (s == cache.series.end()) {
+            metrics::labels_type const labels(
+                { std::make_pair("engine", r.engine)
+                , std::make_pair("kind",   "requests")
+                , std::make_pair("scope",  "per_thread")
+                });
+            series_type const series =
+                { metrics::counter("synth_cache_hits_total",   labels)
+                , metrics::counter("synth_cache_misses_total", labels)
+                , metrics::gauge  ("synth_cache_entries",      labels)
+                };
+            s = cache.series.insert(std::make_pair(r.engine, series)).first;
+        }
+
+        typename entries_type::const_iterator const it = cache.entries.find(key);
+        if (it != cache.entries.end()) {
+            metrics::count(s->second.hits);
+            return it->second;
+        }
+
+        metrics::count(s->second.misses);
+        cached_type const entry(new entry_type(r.source, text::widen(r.engine), options));
+        if (cache.entries.size() >= max_entries) {
+            // NOTE: Entries are counted per engine, so each engine's share is taken off separately.
+            for (auto& series : cache.series) {
+                std::size_t n = 0;
+                for (auto const& e : cache.entries) {
+                    n += e.first.compare(0, series.first.size() + 1, series.first + '\0') == 0;
+                }
+                metrics::adjust(series.second.entries, -double(n));
+            }
+            cache.entries.clear();
+        }
+        cache.entries[key] = entry;
+        metrics::adjust(s->second.entries, 1);
+        return entry;
+    }
+
+  private:
+
+    std::string const       path_;
+    std::size_t const       workers_;
+    int                     fd_;
+    bool                    bound_;
+    std::mutex              mutex_;
+    std::condition_variable ready_;
+    std::deque<int>         connections_;
+};
+
+}}}} // namespace ajg::synth::bindings::command_line
+
+#endif // AJG_SYNTH_BINDINGS_COMMAND_LINE_SERVER_HPP_INCLUDED
@@ -15,7 +15,9 @@
 // #include <boost/utility/base_from_member.hpp>
 
 #include <ajg/synth/engines.hpp>
+#include <ajg/synth/metrics.hpp>
 #include <ajg/synth/exceptions.hpp>
+#include <ajg/synth/detail/buffer_pool.hpp>
 #include <ajg/synth/bindings/base_binding.hpp>
 #include <ajg/synth/bindings/python/adapter.hpp>
 #include <ajg/synth/bindings/python/loader.hpp>
@@ -35,6 +37,11 @@ inline char const* version() {
     return AJG_SYNTH_VERSION_STRING;
 }
 
+// Either "prometheus" (text exposition format) or "json".
+inline std::string metrics(std::string const& format) {
+    return synth::metrics::dump(format);
+}
+
 template <class Traits>
 struct binding : bindings::base_binding< Traits
                                        , py::object const&
@@ -105,6 +112,8 @@ struct binding : bindings::base_binding< Traits
             if (PyMapping_HasKeyString(opts.ptr(), const_cast<char*>("libraries")))   options.libraries        = make_libraries(py::dict(opts["libraries"]));
             if (PyMapping_HasKeyString(opts.ptr(), const_cast<char*>("loaders")))     options.loaders          = make_loaders(py::list(opts["loaders"]));
             if (PyMapping_HasKeyString(opts.ptr(), const_cast<char*>("resolvers")))   options.resolvers        = make_resolvers(py::list(opts["resolvers"]));
+            if (PyMapping_HasKeyString(opts.ptr(), const_cast<char*>("parse_step_limit"))) options.parse_step_limit = py::extract<size_type>(opts["parse_step_limit"]);
+            if (PyMapping_HasKeyString(opts.ptr(), const_cast<char*>("parse_time_limit"))) options.parse_time_limit = py::extract<size_type>(opts["parse_time_limit"]);
             if (PyMapping_HasKeyString(opts.ptr(), const_cast<char*>("caching")))     options.caching          = make_caching(opts["caching"]);
             else                                                                      options.caching          = caching_mask(caching_all | caching_per_process);
         }
@@ -114,7 +123,10 @@ struct binding : bindings::base_binding< Traits
   public:
 
     void render_to_file(py::object const& file, py::object& data) const {
-        if (PyFile_WriteString(base_type::render_to_string(data).c_str(), file.ptr()) == -1) {
+        detail::pooled_buffer<string_type> buffer;
+        base_type::render_to_buffer(*buffer, data);
+
+        if (PyFile_WriteString(buffer->c_str(), file.ptr()) == -1) {
             AJG_SYNTH_THROW(std::runtime_error("writing to file failed"));
         }
         /*
@@ -138,8 +150,11 @@ struct binding : bindings::base_binding< Traits
         return base_type::render_to_path(c::make_string(path), data);
     }
 
-    string_type render_to_string(py::object& data) const {
-        return base_type::render_to_string(data);
+    // NOTE: The output is copied into a Python string anyway, so it's rendered into a pooled buffer.
+    py::object render_to_string(py::object& data) const {
+        detail::pooled_buffer<string_type> buffer;
+        base_type::render_to_buffer(*buffer, data);
+        return py::object(*buffer);
     }
 
     static void set_default_options(py::dict const& opts) {
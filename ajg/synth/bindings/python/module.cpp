@@ -23,12 +23,14 @@ BOOST_PYTHON_MODULE(synth) {
     binding_type::prime();
 
     py::def("version", s::bindings::python::version);
+    py::def("metrics", s::bindings::python::metrics, (py::arg("format") = "prometheus"));
 
     py::scope().attr("CACHE_NONE")        = static_cast<std::size_t>(s::caching_none);
     py::scope().attr("CACHE_ALL")         = static_cast<std::size_t>(s::caching_all);
     py::scope().attr("CACHE_PATHS")       = static_cast<std::size_t>(s::caching_paths);
     py::scope().attr("CACHE_BUFFERS")     = static_cast<std::size_t>(s::caching_buffers);
     py::scope().attr("CACHE_STRINGS")     = static_cast<std::size_t>(s::caching_strings);
+    py::scope().attr("CACHE_FILES")       = static_cast<std::size_t>(s::caching_files);
     py::scope().attr("CACHE_PER_THREAD")  = static_cast<std::size_t>(s::caching_per_thread);
     py::scope().attr("CACHE_PER_PROCESS") = static_cast<std::size_t>(s::caching_per_process);
 
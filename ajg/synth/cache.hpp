@@ -10,9 +10,13 @@
 #include <map>
 #include <string>
 #include <vector>
+#include <utility>
+#include <stdexcept>
 
-#include <ajg/synth/detail/text.hpp>
+#include <ajg/synth/metrics.hpp>
 #include <ajg/synth/templates.hpp>
+#include <ajg/synth/detail/text.hpp>
+#include <ajg/synth/detail/file_cache.hpp>
 
 namespace ajg {
 namespace synth {
@@ -32,6 +36,7 @@ enum caching_mask {
     caching_buffers     = (1 << 2),
     caching_strings     = (1 << 3),
     // caching_streams  = (1 << 4),
+    caching_files       = (1 << 5), // Raw file contents & metadata (e.g. for ssi, fsize, flastmod.)
 
     caching_per_thread  = (1 << 10),
     caching_per_process = (1 << 11)
@@ -85,6 +90,8 @@ struct cache {
     typedef typename traits_type::ostream_type                                  ostream_type;
 
     typedef boost::shared_ptr<template_type const>                              cached_type; // TODO[c++11]: Use unique_ptr?
+    typedef typename template_type::footprint_type                              footprint_type;
+    typedef std::vector<std::pair<cached_type, footprint_type> >                footprints_type;
 
   private:
 
@@ -95,7 +102,12 @@ struct cache {
 
   public:
 
-    cache() {}
+    explicit cache(char const* const scope = "user")
+        : hits_    (metrics::counter("synth_cache_hits_total",     labels(scope)))
+        , misses_  (metrics::counter("synth_cache_misses_total",   labels(scope)))
+        , reparses_(metrics::counter("synth_cache_reparses_total", labels(scope)))
+        , entries_ (metrics::gauge  ("synth_cache_entries",        labels(scope)))
+        , bytes_   (metrics::gauge  ("synth_cache_bytes",          labels(scope))) {}
 
   public:
 
@@ -106,25 +118,105 @@ struct cache {
         for (it_type it = r.first; it != r.second; ++it) {
             if (it->second->same(source, options)) {
                 if (it->second->stale(source, options)) {
+                    metrics::count(this->reparses_);
                     // TODO: Introduce a way to reuse the template's state by re-parsing the source,
                     //       that way the contained xpressive::match_results can be reused too,
                     //       which is recommended as it is consumes a good chunk of memory.
+                    metrics::adjust(this->bytes_, -double(it->second->footprint().total()));
                     it->second.reset(new template_type(source, options));
+                    metrics::adjust(this->bytes_, double(it->second->footprint().total()));
+                }
+                else {
+                    metrics::count(this->hits_);
                 }
                 return it->second;
             }
         }
 
+        metrics::count(this->misses_);
         cached_type const t(new template_type(source, options));
         this->cache_.insert(std::pair<key_type, cached_type>(key, t));
+        metrics::adjust(this->entries_, 1);
+        metrics::adjust(this->bytes_, double(t->footprint().total()));
         return t;
     }
 
+//
+// cache::footprints, cache::footprint:
+//     Approximately how many bytes each template cached retains, or all of them together (along
+//     with the cache's own bookkeeping); the same totals are also kept as synth_cache_bytes.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    footprints_type footprints() const {
+        footprints_type footprints;
+        footprints.reserve(this->cache_.size());
+
+        for (auto const& entry : this->cache_) {
+            footprints.push_back(std::make_pair(entry.second, entry.second->footprint()));
+        }
+        return footprints;
+    }
+
+    footprint_type footprint() const {
+        footprint_type result;
+        result.other = footprint_type::map(this->cache_);
+
+        for (auto const& entry : this->cache_) {
+            result += entry.second->footprint();
+        }
+        return result;
+    }
+
   private:
 
-    cache_type cache_;
+    inline static metrics::labels_type labels(char const* const scope) {
+        return metrics::labels_type(
+            { std::make_pair("engine", engine_type::name())
+            , std::make_pair("kind",   kind_name(caching_mask_for<template_type>::value))
+            , std::make_pair("scope",  scope)
+            });
+    }
+
+    inline static char const* kind_name(caching_mask const mask) {
+        switch (mask) {
+        case caching_paths:   return "paths";
+        case caching_buffers: return "buffers";
+        case caching_strings: return "strings";
+        default:              return "none";
+        }
+    }
+
+  private:
+
+    cache_type            cache_;
+    metrics::series const hits_;
+    metrics::series const misses_;
+    metrics::series const reparses_;
+    metrics::series const entries_;
+    metrics::series const bytes_;
 };
 
+//
+// thread_cache, process_cache:
+//     The caches used by parse_template, e.g. to inspect what they hold.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename Template>
+inline cache<Template>& thread_cache() {
+    // FIXME: Destroy at program end to avoid leak (currently sigsegvs from Python.)
+    static AJG_SYNTH_THREAD_LOCAL cache<Template>* instance = 0;
+    if (instance == 0) instance = new cache<Template>("per_thread");
+    return *instance;
+}
+
+template <typename Template>
+inline cache<Template>& process_cache() {
+    // FIXME: Destroy at program end to avoid leak (currently sigsegvs from Python.)
+    // FIXME: Make thread-safe (consider using concurrent hopscotch hashing.)
+    static cache<Template>* const instance = new cache<Template>("per_process");
+    return *instance;
+}
+
 // TODO: Make the cache used a parameter.
 template <typename Template>
 inline typename cache<Template>::cached_type parse_template
@@ -133,23 +225,38 @@ inline typename cache<Template>::cached_type parse_template
         ) {
     caching_mask const m = caching_mask_for<Template>::value;
     AJG_SYNTH_ASSERT((m & (m - 1)) == 0);
-    bool const enabled = (options.caching & m) || (options.caching & caching_all);
+    // Note: Templates without a kind of their own (i.e. streams) have nothing stable to key them
+    //       by, so they're never cached, not even under caching_all.
+    bool const enabled = m != caching_none && ((options.caching & m) || (options.caching & caching_all));
     if (!enabled) {
         return typename cache<Template>::cached_type(new Template(source, options));
     }
     // XXX: static cache<Template> global_cache;
 
     else if (options.caching & caching_per_thread) {
-        // FIXME: Destroy at program end to avoid leak (currently sigsegvs from Python.)
-        static AJG_SYNTH_THREAD_LOCAL cache<Template>* thread_cache = 0;
-        if (thread_cache == 0) thread_cache = new cache<Template>;
-        return thread_cache->get_or_parse(source, options);
+        return thread_cache<Template>().get_or_parse(source, options);
     }
     else if (options.caching & caching_per_process) {
-        // FIXME: Destroy at program end to avoid leak (currently sigsegvs from Python.)
-        // FIXME: Make thread-safe (consider using concurrent hopscotch hashing.)
-        static cache<Template>* process_cache = new cache<Template>;
-        return process_cache->get_or_parse(source, options);
+        return process_cache<Template>().get_or_parse(source, options);
+    }
+    AJG_SYNTH_THROW(std::invalid_argument("caching must be per-process or per-thread"));
+}
+
+//
+// file_caching_for:
+//     Where raw files are cached, if at all; like templates, they are cached per-thread or
+//     per-process, according to the caching mask.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline detail::file_caching file_caching_for(caching_mask const caching) {
+    if (!(caching & caching_files) && !(caching & caching_all)) {
+        return detail::file_caching_none;
+    }
+    else if (caching & caching_per_thread) {
+        return detail::file_caching_per_thread;
+    }
+    else if (caching & caching_per_process) {
+        return detail::file_caching_per_process;
     }
     AJG_SYNTH_THROW(std::invalid_argument("caching must be per-process or per-thread"));
 }
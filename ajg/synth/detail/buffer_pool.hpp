@@ -0,0 +1,92 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_DETAIL_BUFFER_POOL_HPP_INCLUDED
+#define AJG_SYNTH_DETAIL_BUFFER_POOL_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+
+namespace ajg {
+namespace synth {
+namespace detail {
+
+//
+// pooled_buffer:
+//     Borrows a string from a small per-thread pool for as long as it's in scope, so that output
+//     that's only needed temporarily (e.g. until it's copied elsewhere) reuses earlier storage.
+//     Buffers that grew unusually large are let go of rather than returned, to bound the memory
+//     each thread holds on to.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <class String>
+struct pooled_buffer : boost::noncopyable {
+  public:
+
+    typedef String                                                              string_type;
+
+  private:
+
+    typedef std::vector<string_type>                                            pool_type;
+
+  public:
+
+    pooled_buffer() {
+        pool_type& pool = pooled_buffer::pool();
+
+        if (!pool.empty()) {
+            this->buffer_ = std::move(pool.back());
+            pool.pop_back();
+            this->buffer_.clear();
+        }
+    }
+
+    ~pooled_buffer() {
+        pool_type& pool = pooled_buffer::pool();
+
+        if (pool.size() < max_buffers && this->buffer_.capacity() <= max_capacity) {
+            pool.push_back(std::move(this->buffer_));
+        }
+    }
+
+  public:
+
+    inline string_type&       operator *()       { return this->buffer_; }
+    inline string_type const& operator *() const { return this->buffer_; }
+
+    inline string_type*       operator ->()       { return &this->buffer_; }
+    inline string_type const* operator ->() const { return &this->buffer_; }
+
+  private:
+
+    inline static pool_type& pool() {
+    #if AJG_SYNTH_HAS_CXX11_THREAD_LOCAL
+        static thread_local pool_type pool; // Released along with the thread.
+        return pool;
+    #else
+        // FIXME: Destroy at thread exit to avoid leak.
+        static AJG_SYNTH_THREAD_LOCAL pool_type* pool = 0;
+        if (pool == 0) pool = new pool_type;
+        return *pool;
+    #endif
+    }
+
+  private:
+
+    static std::size_t const max_buffers  = 4;
+    static std::size_t const max_capacity = 256 * 1024; // So each thread keeps at most 1 MiB.
+
+  private:
+
+    string_type buffer_;
+};
+
+}}} // namespace ajg::synth::detail
+
+#endif // AJG_SYNTH_DETAIL_BUFFER_POOL_HPP_INCLUDED
@@ -0,0 +1,287 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_DETAIL_COMMAND_HPP_INCLUDED
+#define AJG_SYNTH_DETAIL_COMMAND_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <stdexcept>
+#include <functional>
+#include <condition_variable>
+
+#include <boost/noncopyable.hpp>
+
+#if !AJG_SYNTH_IS_PLATFORM_WINDOWS
+#    include <poll.h>
+#    include <fcntl.h>
+#    include <signal.h>
+#    include <unistd.h>
+#    include <sys/wait.h>
+extern char **environ;
+#endif
+
+#include <ajg/synth/exceptions.hpp>
+#include <ajg/synth/detail/pipe.hpp>
+
+namespace ajg {
+namespace synth {
+namespace detail {
+
+//
+// command_limits:
+//     How commands are run: ttl is how many seconds a command's output may be reused for (zero to
+//     always run it), timeout how many seconds it may run for before it's killed (zero for no
+//     limit) and concurrency how many commands may run at once, process-wide (zero for no limit.)
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct command_limits {
+    std::size_t ttl;
+    std::size_t timeout;
+    std::size_t concurrency;
+
+    command_limits(std::size_t const ttl = 0, std::size_t const timeout = 0, std::size_t const concurrency = 0)
+        : ttl(ttl), timeout(timeout), concurrency(concurrency) {}
+
+    // Whether commands can simply be run through a pipe, as they are when no limits are set.
+    inline bool unlimited() const { return ttl == 0 && timeout == 0 && concurrency == 0; }
+};
+
+//
+// command_error
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct command_error : public std::runtime_error {
+    command_error(std::string const& command, std::string const& reason)
+        : std::runtime_error("command `" + command + "` " + reason) {}
+};
+
+//
+// run_command:
+//     Runs a command through the shell and returns what it wrote to its standard output. With a
+//     timeout, the child leads a process group of its own, which is killed once it elapses
+//     (whether it's still writing or merely still running) and an error is raised instead;
+//     without one, it stays in ours, so that e.g. a terminal's interrupt reaches it as well.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if AJG_SYNTH_IS_PLATFORM_WINDOWS
+
+inline std::string run_command(std::string const& command, std::size_t const timeout) {
+    // TODO: Support timeouts on Windows (e.g. via CreateProcess and WaitForSingleObject.)
+    std::ostringstream stream;
+    pipe p(command);
+    p.read_into(stream);
+    return stream.str();
+}
+
+#else
+
+inline std::string run_command(std::string const& command, std::size_t const timeout) {
+    // NOTE: Other children (e.g. those forked concurrently) mustn't inherit either end, which would
+    //       delay the reader's EOF until they exit too; only pipe2 does so without a window in which
+    //       another thread could fork, so setting the flags afterwards is merely a fallback.
+    int fds[2];
+#if defined(O_CLOEXEC) && !AJG_SYNTH_IS_PLATFORM_DARWIN
+    if (::pipe2(fds, O_CLOEXEC) != 0) {
+        AJG_SYNTH_THROW(pipe::error("open"));
+    }
+#else
+    if (::pipe(fds) != 0) {
+        AJG_SYNTH_THROW(pipe::error("open"));
+    }
+    ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+    pid_t const pid = ::fork();
+    if (pid < 0) {
+        ::close(fds[0]);
+        ::close(fds[1]);
+        AJG_SYNTH_THROW(pipe::error("fork"));
+    }
+    else if (pid == 0) { // Only async-signal-safe calls from here on.
+        if (timeout != 0) {
+            ::setpgid(0, 0); // Lead a group of our own, so that the whole pipeline can be killed at once.
+        }
+        ::dup2(fds[1], STDOUT_FILENO);
+        ::close(fds[0]);
+        ::close(fds[1]);
+        ::execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char*>(0));
+        ::_exit(127);
+    }
+    ::close(fds[1]);
+    if (timeout != 0) {
+        ::setpgid(pid, pid); // Also here, in case we need to kill the group before the child has run.
+    }
+
+    typedef std::chrono::steady_clock clock_type;
+    clock_type::time_point const deadline = clock_type::now() + std::chrono::seconds(timeout);
+    std::string output;
+    char buffer[read_buffer_size];
+    bool timed_out = false;
+
+    for (;;) {
+        int wait = -1;
+        if (timeout != 0) {
+            long long const left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock_type::now()).count();
+            wait = left <= 0 ? 0 : left >= INT_MAX ? INT_MAX : static_cast<int>(left);
+        }
+
+        struct pollfd readable = { fds[0], POLLIN, 0 };
+        int const ready = ::poll(&readable, 1, wait);
+
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        else if (ready == 0) {
+            timed_out = true;
+            ::kill(-pid, SIGKILL);
+            break;
+        }
+
+        ssize_t const n = ::read(fds[0], buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        else if (n <= 0) {
+            break;
+        }
+        output.append(buffer, static_cast<std::size_t>(n));
+    }
+
+    ::close(fds[0]);
+    int status = 0;
+
+    for (;;) { // The child may well outlive its output, so keep waiting within the same deadline.
+        bool  const blocking = timed_out || timeout == 0;
+        pid_t const waited   = ::waitpid(pid, &status, blocking ? 0 : WNOHANG);
+
+        if (waited < 0 && errno == EINTR) {
+            continue;
+        }
+        else if (waited != 0) {
+            break;
+        }
+        else if (clock_type::now() >= deadline) {
+            timed_out = true;
+            ::kill(-pid, SIGKILL);
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    if (timed_out) {
+        AJG_SYNTH_THROW(command_error(command, "timed out"));
+    }
+    return output;
+}
+
+#endif
+
+//
+// command_slot:
+//     Holds one of a bounded number of process-wide slots for running commands, while in scope.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct command_slot : boost::noncopyable {
+  public:
+
+    explicit command_slot(std::size_t const limit) : limit_(limit) {
+        if (this->limit_ != 0) {
+            std::unique_lock<std::mutex> lock(mutex());
+            while (running() >= this->limit_) {
+                released().wait(lock);
+            }
+            ++running();
+        }
+    }
+
+    ~command_slot() {
+        if (this->limit_ != 0) {
+            std::lock_guard<std::mutex> const lock(mutex());
+            --running();
+            released().notify_all(); // Waiters may have different limits.
+        }
+    }
+
+  private:
+
+    inline static std::mutex&              mutex()    { static std::mutex m;              return m; }
+    inline static std::condition_variable& released() { static std::condition_variable c; return c; }
+    inline static std::size_t&             running()  { static std::size_t n = 0;         return n; }
+
+  private:
+
+    std::size_t const limit_;
+};
+
+//
+// execute_command:
+//     Runs a command within the given limits, reusing the output of an identical command run in
+//     an identical environment within the last ttl seconds, if any.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline std::size_t environment_fingerprint() {
+    std::size_t seed = 0;
+#if !AJG_SYNTH_IS_PLATFORM_WINDOWS
+    std::hash<std::string> const hash;
+    for (char** variable = environ; variable && *variable; ++variable) {
+        seed ^= hash(*variable) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+#endif
+    return seed;
+}
+
+inline std::string execute_command(std::string const& command, command_limits const& limits) {
+    typedef std::chrono::steady_clock                                           clock_type;
+    typedef std::pair<std::string, std::size_t>                                 key_type;
+    typedef std::pair<clock_type::time_point, std::string>                      entry_type;
+    typedef std::map<key_type, entry_type>                                      entries_type;
+
+    static std::size_t const max_entries = 256;
+    static std::mutex mutex;
+    static entries_type entries;
+
+    if (limits.ttl == 0) {
+        command_slot const slot(limits.concurrency);
+        return run_command(command, limits.timeout);
+    }
+
+    key_type const key(command, environment_fingerprint());
+    {
+        std::lock_guard<std::mutex> const lock(mutex);
+        entries_type::const_iterator const it = entries.find(key);
+        if (it != entries.end() && clock_type::now() < it->second.first) {
+            return it->second.second;
+        }
+    }
+
+    std::string output;
+    {
+        command_slot const slot(limits.concurrency);
+        output = run_command(command, limits.timeout);
+    }
+
+    std::lock_guard<std::mutex> const lock(mutex);
+    if (entries.size() >= max_entries) {
+        entries.clear();
+    }
+    entries[key] = entry_type(clock_type::now() + std::chrono::seconds(limits.ttl), output);
+    return output;
+}
+
+}}} // namespace ajg::synth::detail
+
+#endif // AJG_SYNTH_DETAIL_COMMAND_HPP_INCLUDED
@@ -0,0 +1,95 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_DETAIL_DIGEST_STREAMBUF_HPP_INCLUDED
+#define AJG_SYNTH_DETAIL_DIGEST_STREAMBUF_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <ios>
+#include <string>
+#include <cstddef>
+#include <streambuf>
+
+#include <boost/noncopyable.hpp>
+#include <boost/type_traits/make_unsigned.hpp>
+
+namespace ajg {
+namespace synth {
+namespace detail {
+
+//
+// digest_basis, digest_prime, digest_bytes:
+//     The parameters of the (FNV-1a) hash used for digests, and the hash itself over raw bytes.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline std::size_t digest_basis() { return sizeof(std::size_t) >= 8 ? std::size_t(14695981039346656037ULL) : std::size_t(2166136261UL); }
+inline std::size_t digest_prime() { return sizeof(std::size_t) >= 8 ? std::size_t(1099511628211ULL)        : std::size_t(16777619UL); }
+
+inline std::size_t digest_bytes(char const* const data, std::size_t const size, std::size_t digest = digest_basis()) {
+    for (char const* p = data, *const end = data + size; p != end; ++p) {
+        digest = (digest ^ static_cast<std::size_t>(static_cast<unsigned char>(*p))) * digest_prime();
+    }
+    return digest;
+}
+
+//
+// digest_streambuf:
+//     Appends everything written to it to a scratch string while computing a running (FNV-1a)
+//     hash of it, so that output can be compared to earlier output without keeping the latter.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <class Char, class Traits = std::char_traits<Char> >
+struct digest_streambuf : std::basic_streambuf<Char, Traits>, boost::noncopyable {
+  public:
+
+    typedef Char                                                                char_type;
+    typedef Traits                                                              traits_type;
+    typedef typename traits_type::int_type                                      int_type;
+    typedef std::basic_string<char_type, traits_type>                           string_type;
+    typedef std::size_t                                                         digest_type;
+
+  public:
+
+    explicit digest_streambuf(string_type& scratch)
+        : scratch_(scratch), digest_(digest_basis()) { this->scratch_.clear(); }
+
+  public:
+
+    inline digest_type        digest()  const { return this->digest_; }
+    inline string_type const& scratch() const { return this->scratch_; }
+
+  protected:
+
+    virtual int_type overflow(int_type const c) {
+        if (traits_type::eq_int_type(c, traits_type::eof())) {
+            return traits_type::not_eof(c);
+        }
+        char_type const ch = traits_type::to_char_type(c);
+        this->xsputn(&ch, 1);
+        return c;
+    }
+
+    virtual std::streamsize xsputn(char_type const* const s, std::streamsize const n) {
+        typedef typename boost::make_unsigned<char_type>::type unsigned_type;
+        digest_type digest = this->digest_;
+
+        for (char_type const* p = s, *const end = s + n; p != end; ++p) {
+            digest = (digest ^ static_cast<digest_type>(static_cast<unsigned_type>(*p))) * digest_prime();
+        }
+
+        this->digest_ = digest;
+        this->scratch_.append(s, static_cast<std::size_t>(n));
+        return n;
+    }
+
+  private:
+
+    string_type& scratch_;
+    digest_type  digest_;
+};
+
+}}} // namespace ajg::synth::detail
+
+#endif // AJG_SYNTH_DETAIL_DIGEST_STREAMBUF_HPP_INCLUDED
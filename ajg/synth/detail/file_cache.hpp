@@ -0,0 +1,246 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_DETAIL_FILE_CACHE_HPP_INCLUDED
+#define AJG_SYNTH_DETAIL_FILE_CACHE_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <sys/stat.h>
+
+#if !AJG_SYNTH_IS_PLATFORM_WINDOWS
+#    include <fcntl.h>
+#    include <unistd.h>
+#    include <sys/mman.h>
+#endif
+
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <ajg/synth/exceptions.hpp>
+#include <ajg/synth/detail/filesystem.hpp>
+
+namespace ajg {
+namespace synth {
+namespace detail {
+
+//
+// file_contents:
+//     The raw bytes of a file, normally copied into memory; large files can be mapped into it
+//     instead, but only when the caller holds them briefly and owns the file (e.g. the command-line
+//     tool's own context), since reading a mapped file that's since been truncated faults.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct file_contents : boost::noncopyable {
+  public:
+
+    static std::size_t const mapping_threshold = 64 * 1024;
+
+  public:
+
+    explicit file_contents(std::string const& path, bool const mappable = false)
+            : data_(0), size_(0), mapped_(false) {
+        struct stat const stats = stat_file(path);
+        std::size_t const size  = static_cast<std::size_t>(stats.st_size);
+
+    #if !AJG_SYNTH_IS_PLATFORM_WINDOWS
+        if (mappable && size >= mapping_threshold) {
+            int const fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                AJG_SYNTH_THROW(read_error(path, std::strerror(errno)));
+            }
+
+            void* const mapping = ::mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+
+            if (mapping != MAP_FAILED) {
+                this->data_   = static_cast<char const*>(mapping);
+                this->size_   = size;
+                this->mapped_ = true;
+                return;
+            } // Otherwise, fall back to reading it normally.
+        }
+    #endif
+
+        FILE* const file = (std::fopen)(path.c_str(), "rb");
+        if (file == 0) {
+            AJG_SYNTH_THROW(read_error(path, std::strerror(errno)));
+        }
+
+        this->buffer_.reserve(size);
+        char buffer[read_buffer_size];
+        while (std::size_t const n = std::fread(buffer, 1, sizeof(buffer), file)) {
+            this->buffer_.append(buffer, n);
+        }
+        (std::fclose)(file);
+
+        this->data_ = this->buffer_.data();
+        this->size_ = this->buffer_.size();
+    }
+
+    ~file_contents() {
+    #if !AJG_SYNTH_IS_PLATFORM_WINDOWS
+        if (this->mapped_) {
+            ::munmap(const_cast<char*>(this->data_), this->size_);
+        }
+    #endif
+    }
+
+  public:
+
+    inline char const* data() const { return this->data_; }
+    inline std::size_t size() const { return this->size_; }
+
+  private:
+
+    std::string buffer_;
+    char const* data_;
+    std::size_t size_;
+    bool        mapped_;
+};
+
+//
+// file_revalidation_interval:
+//     How long cached file information is trusted for before the file is looked at again; this
+//     matches the resolution of modification times on most filesystems.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef std::chrono::steady_clock file_clock_type;
+
+inline file_clock_type::duration file_revalidation_interval() {
+    return std::chrono::seconds(1);
+}
+
+//
+// file_caching:
+//     Whether (and with whom) file contents and metadata are shared, following the caching scope.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum file_caching {
+    file_caching_none,
+    file_caching_per_thread,
+    file_caching_per_process
+};
+
+//
+// file_cache:
+//     Contents and stat results of files, each redone at most once per interval; contents are
+//     reloaded whenever the file's modification time or size differ from when they were loaded.
+//     Contents are always copied, never mapped, since they outlive any one render.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct file_cache : boost::noncopyable {
+  public:
+
+    typedef boost::shared_ptr<file_contents const>                              contents_type;
+
+  private:
+
+    typedef std::pair<file_clock_type::time_point, struct stat>                 stat_entry_type;
+    typedef std::map<std::string, stat_entry_type>                              stat_entries_type;
+    typedef std::pair<struct stat, contents_type>                               contents_entry_type;
+    typedef std::map<std::string, contents_entry_type>                          contents_entries_type;
+
+    static std::size_t const max_stat_entries     = 1024;
+    static std::size_t const max_contents_entries = 256;
+
+  public:
+
+    struct stat stats(std::string const& path) {
+        file_clock_type::time_point const now = file_clock_type::now();
+        {
+            std::lock_guard<std::mutex> const lock(this->mutex_);
+            stat_entries_type::const_iterator const it = this->stats_.find(path);
+            if (it != this->stats_.end() && now < it->second.first) {
+                return it->second.second;
+            }
+        }
+
+        struct stat const stats = stat_file(path);
+
+        std::lock_guard<std::mutex> const lock(this->mutex_);
+        if (this->stats_.size() >= max_stat_entries) {
+            this->stats_.clear();
+        }
+        this->stats_[path] = stat_entry_type(now + file_revalidation_interval(), stats);
+        return stats;
+    }
+
+    contents_type contents(std::string const& path) {
+        struct stat const current = this->stats(path);
+        {
+            std::lock_guard<std::mutex> const lock(this->mutex_);
+            contents_entries_type::const_iterator const it = this->contents_.find(path);
+            if (it != this->contents_.end() && it->second.first.st_mtime == current.st_mtime
+                                            && it->second.first.st_size  == current.st_size) {
+                return it->second.second;
+            }
+        }
+
+        contents_type const contents(new file_contents(path));
+
+        std::lock_guard<std::mutex> const lock(this->mutex_);
+        if (this->contents_.size() >= max_contents_entries) {
+            this->contents_.clear();
+        }
+        this->contents_[path] = contents_entry_type(current, contents);
+        return contents;
+    }
+
+  private:
+
+    std::mutex            mutex_;
+    stat_entries_type     stats_;
+    contents_entries_type contents_;
+};
+
+//
+// thread_file_cache, process_file_cache:
+//     The file caches used per-thread and per-process, respectively.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline file_cache& thread_file_cache() {
+    // FIXME: Destroy at thread end to avoid leak.
+    static AJG_SYNTH_THREAD_LOCAL file_cache* instance = 0;
+    if (instance == 0) instance = new file_cache;
+    return *instance;
+}
+
+inline file_cache& process_file_cache() {
+    static file_cache* const instance = new file_cache;
+    return *instance;
+}
+
+//
+// stat_file, read_file_contents:
+//     Shortcuts to choose between the cached and uncached versions of each operation.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline struct stat stat_file(std::string const& path, file_caching const caching) {
+    switch (caching) {
+    case file_caching_per_thread:  return thread_file_cache().stats(path);
+    case file_caching_per_process: return process_file_cache().stats(path);
+    default:                       return stat_file(path);
+    }
+}
+
+inline boost::shared_ptr<file_contents const> read_file_contents(std::string const& path, file_caching const caching) {
+    switch (caching) {
+    case file_caching_per_thread:  return thread_file_cache().contents(path);
+    case file_caching_per_process: return process_file_cache().contents(path);
+    default:                       return boost::shared_ptr<file_contents const>(new file_contents(path));
+    }
+}
+
+}}} // namespace ajg::synth::detail
+
+#endif // AJG_SYNTH_DETAIL_FILE_CACHE_HPP_INCLUDED
@@ -0,0 +1,97 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_DETAIL_FORMAT_NUMBER_HPP_INCLUDED
+#define AJG_SYNTH_DETAIL_FORMAT_NUMBER_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <vector>
+#include <cstdio>
+#include <cstddef>
+
+#include <boost/type_traits/make_unsigned.hpp>
+
+namespace ajg {
+namespace synth {
+namespace detail {
+
+//
+// integer_digits:
+//     Enough room for any integer up to 128 bits, in decimal, with a sign.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+std::size_t const integer_digits = 48;
+
+//
+// format_integer:
+//     Writes n in decimal backwards from end, returning the new beginning; digits and sign only,
+//     which is what num_put produces for std::dec under any locale without grouping.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <class Char, class Integer>
+inline Char* format_integer(Char* end, Integer const n) {
+    typedef typename boost::make_unsigned<Integer>::type unsigned_type;
+    bool const negative = n < Integer(0);
+    unsigned_type u = negative ? unsigned_type(unsigned_type(0) - unsigned_type(n)) : unsigned_type(n);
+
+    do {
+        *--end = static_cast<Char>('0' + static_cast<int>(u % 10));
+        u /= 10;
+    } while (u);
+
+    if (negative) {
+        *--end = Char('-');
+    }
+    return end;
+}
+
+//
+// format_floating:
+//     Appends n to s using the given printf conversion ('g' for the stream default, 'f' for
+//     std::fixed) and precision, which is exactly what num_put does internally; the decimal point is
+//     normalized in case the C locale has been changed to one with a different one.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline int print_floating(char* const buffer, std::size_t const size, int const precision, char const conversion, double const n) {
+    char const format[] = {'%', '.', '*', conversion, '\0'};
+    return std::snprintf(buffer, size, format, precision, n);
+}
+
+inline int print_floating(char* const buffer, std::size_t const size, int const precision, char const conversion, long double const n) {
+    char const format[] = {'%', '.', '*', 'L', conversion, '\0'};
+    return std::snprintf(buffer, size, format, precision, n);
+}
+
+inline int print_floating(char* const buffer, std::size_t const size, int const precision, char const conversion, float const n) {
+    return print_floating(buffer, size, precision, conversion, static_cast<double>(n));
+}
+
+template <class String, class Floating>
+inline void format_floating(String& s, Floating const n, int const precision, char const conversion = 'g') {
+    char buffer[64];
+    std::vector<char> large;
+    char* p = buffer;
+    int size = print_floating(buffer, sizeof(buffer), precision, conversion, n);
+
+    if (size < 0) {
+        return;
+    }
+    else if (static_cast<std::size_t>(size) >= sizeof(buffer)) {
+        large.resize(size + 1);
+        p = &large[0];
+        size = print_floating(p, large.size(), precision, conversion, n);
+    }
+
+    s.reserve(s.size() + size);
+    for (char const* const end = p + size; p != end; ++p) {
+        char const c = *p;
+        bool const numeric = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+';
+        s += static_cast<typename String::value_type>(numeric ? c : '.');
+    }
+}
+
+}}} // namespace ajg::synth::detail
+
+#endif // AJG_SYNTH_DETAIL_FORMAT_NUMBER_HPP_INCLUDED
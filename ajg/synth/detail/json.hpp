@@ -0,0 +1,492 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_DETAIL_JSON_HPP_INCLUDED
+#define AJG_SYNTH_DETAIL_JSON_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <ajg/synth/exceptions.hpp>
+#include <ajg/synth/detail/file_cache.hpp>
+
+namespace ajg {
+namespace synth {
+namespace detail {
+
+struct json_document;
+
+//
+// json_value:
+//     A lightweight handle to a node within a json_document, which must outlive it.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct json_value {
+  public:
+
+    json_value(json_document const* const document = 0, std::size_t const index = 0)
+        : document(document), index(index) {}
+
+  public:
+
+    inline bool operator ==(json_value const& that) const {
+        return this->document == that.document && this->index == that.index;
+    }
+
+    inline bool operator <(json_value const& that) const {
+        return this->document < that.document || (this->document == that.document && this->index < that.index);
+    }
+
+  public:
+
+    json_document const* document;
+    std::size_t          index;
+};
+
+//
+// json_document:
+//     A parsed JSON text, kept as a flat, pre-ordered array of typed nodes. Strings without escapes
+//     aren't copied but point into the text itself (which may be a mapped file), and every object
+//     gets an open-addressed hash table of its keys, all of which live in a single array. Numbers
+//     keep their lexeme too, so they can be output exactly as written; those too large to convert
+//     (e.g. integers beyond 64 bits) are kept as strings instead.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct json_document : boost::noncopyable {
+  public:
+
+    enum kind_type { null_kind, boolean_kind, integer_kind, floating_kind, string_kind, array_kind, object_kind };
+
+    typedef boost::uint32_t                                                     index_type;
+    typedef boost::int64_t                                                      integer_type;
+    typedef double                                                              floating_type;
+
+    static std::size_t const max_depth = 512;
+
+  public:
+
+    explicit json_document(std::string const& text) : text_(text) {
+        this->parse(this->text_.data(), this->text_.size());
+    }
+
+    explicit json_document(boost::shared_ptr<file_contents const> const& contents) : contents_(contents) {
+        this->parse(this->contents_->data(), this->contents_->size());
+    }
+
+  public:
+
+    inline kind_type     kind    (std::size_t const i) const { return kind_type(this->nodes_[i].kind); }
+    inline bool          boolean (std::size_t const i) const { return this->nodes_[i].boolean; }
+    inline integer_type  integer (std::size_t const i) const { return this->nodes_[i].integer; }
+    inline floating_type floating(std::size_t const i) const { return this->nodes_[i].floating; }
+
+    // The number of elements or members in a container, or the length of a string or a number.
+    inline std::size_t size(std::size_t const i) const { return this->nodes_[i].size; }
+
+    inline char const* chars(std::size_t const i) const {
+        node const& n = this->nodes_[i];
+        return (n.escaped ? this->decoded_.data() : this->data_) + n.offset;
+    }
+
+    inline std::string string(std::size_t const i) const {
+        return std::string(this->chars(i), this->size(i));
+    }
+
+    // Children (and in objects, keys and values alternately) are iterated as [first, last).
+    inline std::size_t first(std::size_t const i) const { return i + 1; }
+    inline std::size_t last (std::size_t const i) const { return this->nodes_[i].end; }
+    inline std::size_t next (std::size_t const i) const { return this->nodes_[i].end; }
+
+    // Returns the index of the value with the given key in an object, or zero if there's none.
+    inline std::size_t find(std::size_t const i, char const* const key, std::size_t const length) const {
+        node const& object = this->nodes_[i];
+        if (object.kind != object_kind || object.size == 0) {
+            return 0;
+        }
+
+        std::size_t const mask = capacity(object.size) - 1;
+        for (std::size_t slot = hash(key, length) & mask;; slot = (slot + 1) & mask) {
+            index_type const k = this->slots_[object.offset + slot];
+            if (k == 0) {
+                return 0;
+            }
+            else if (this->size(k) == length && std::memcmp(this->chars(k), key, length) == 0) {
+                return this->next(k);
+            }
+        }
+    }
+
+  private:
+
+    struct node {
+        unsigned char kind;
+        bool          escaped; // Whether a string was decoded, or still lies within the text.
+        index_type    size;
+        index_type    offset;  // Of a string's or number's characters, or of an object's slots.
+        index_type    end;     // One past the node's last descendant.
+        union {
+            bool          boolean;
+            integer_type  integer;
+            floating_type floating;
+        };
+    };
+
+    inline static std::size_t capacity(std::size_t const members) {
+        std::size_t c = 2;
+        while (c < 2 * members) c *= 2;
+        return c;
+    }
+
+    inline static std::size_t hash(char const* const s, std::size_t const n) { // FNV-1a.
+        boost::uint32_t h = 2166136261u;
+        for (std::size_t i = 0; i < n; ++i) {
+            h = (h ^ static_cast<unsigned char>(s[i])) * 16777619u;
+        }
+        return h;
+    }
+
+//
+// parsing
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void parse(char const* const data, std::size_t const size) {
+        if (size >= index_type(-1)) {
+            AJG_SYNTH_THROW(std::length_error("json text"));
+        }
+
+        this->data_ = data;
+        this->p_    = data;
+        this->end_  = data + size;
+        this->nodes_.reserve(size / 16 + 1);
+
+        this->parse_value(0);
+        this->skip_space();
+
+        if (this->p_ != this->end_) {
+            this->fail();
+        }
+    }
+
+    inline void parse_value(std::size_t const depth) {
+        this->skip_space();
+        if (this->p_ == this->end_ || depth > max_depth) {
+            this->fail();
+        }
+
+        switch (*this->p_) {
+        case '{': return this->parse_object(depth);
+        case '[': return this->parse_array(depth);
+        case '"': return this->parse_string();
+        case 't': return this->parse_literal("true",  boolean_kind, true);
+        case 'f': return this->parse_literal("false", boolean_kind, false);
+        case 'n': return this->parse_literal("null",  null_kind,    false);
+        default:  return this->parse_number();
+        }
+    }
+
+    inline void parse_object(std::size_t const depth) {
+        std::size_t const i = this->push(object_kind);
+        index_type members = 0;
+        ++this->p_;
+
+        if (!this->accept('}')) {
+            do {
+                this->skip_space();
+                if (this->p_ == this->end_ || *this->p_ != '"') {
+                    this->fail();
+                }
+                this->parse_string();
+                this->expect(':');
+                this->parse_value(depth + 1);
+                ++members;
+            } while (this->accept(','));
+            this->expect('}');
+        }
+
+        this->nodes_[i].size = members;
+        this->nodes_[i].end  = index_type(this->nodes_.size());
+        this->index(i);
+    }
+
+    inline void parse_array(std::size_t const depth) {
+        std::size_t const i = this->push(array_kind);
+        index_type elements = 0;
+        ++this->p_;
+
+        if (!this->accept(']')) {
+            do {
+                this->parse_value(depth + 1);
+                ++elements;
+            } while (this->accept(','));
+            this->expect(']');
+        }
+
+        this->nodes_[i].size = elements;
+        this->nodes_[i].end  = index_type(this->nodes_.size());
+    }
+
+    inline void parse_string() {
+        std::size_t const i = this->push(string_kind);
+        char const* const begin = ++this->p_;
+
+        // Fast path: no escapes, so the string can be referred to in place.
+        while (this->p_ != this->end_ && *this->p_ != '"' && *this->p_ != '\\') {
+            ++this->p_;
+        }
+        if (this->p_ == this->end_) {
+            this->fail();
+        }
+        else if (*this->p_ == '"') {
+            this->nodes_[i].offset = index_type(begin - this->data_);
+            this->nodes_[i].size   = index_type(this->p_++ - begin);
+            return;
+        }
+
+        std::size_t const offset = this->decoded_.size();
+        this->decoded_.append(begin, this->p_);
+
+        while (this->p_ != this->end_ && *this->p_ != '"') {
+            char const c = *this->p_++;
+            if (c != '\\') {
+                this->decoded_ += c;
+                continue;
+            }
+            else if (this->p_ == this->end_) {
+                this->fail();
+            }
+
+            switch (char const e = *this->p_++) {
+            case '"':  case '\\': case '/': this->decoded_ += e; break;
+            case 'b':  this->decoded_ += '\b'; break;
+            case 'f':  this->decoded_ += '\f'; break;
+            case 'n':  this->decoded_ += '\n'; break;
+            case 'r':  this->decoded_ += '\r'; break;
+            case 't':  this->decoded_ += '\t'; break;
+            case 'u':  this->decode_code_point(); break;
+            default:   this->fail();
+            }
+        }
+        if (this->p_ == this->end_) {
+            this->fail();
+        }
+        ++this->p_;
+
+        this->nodes_[i].escaped = true;
+        this->nodes_[i].offset  = index_type(offset);
+        this->nodes_[i].size    = index_type(this->decoded_.size() - offset);
+    }
+
+    inline void decode_code_point() {
+        unsigned long c = this->parse_hex();
+
+        if (c >= 0xD800 && c <= 0xDBFF) { // A high surrogate, which must be followed by a low one.
+            if (this->end_ - this->p_ < 6 || this->p_[0] != '\\' || this->p_[1] != 'u') {
+                this->fail();
+            }
+            this->p_ += 2;
+            unsigned long const low = this->parse_hex();
+            if (low < 0xDC00 || low > 0xDFFF) {
+                this->fail();
+            }
+            c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+        }
+        else if (c >= 0xDC00 && c <= 0xDFFF) { // A low surrogate without a high one.
+            this->fail();
+        }
+
+        // Encode as UTF-8.
+        if (c < 0x80) {
+            this->decoded_ += char(c);
+        }
+        else if (c < 0x800) {
+            this->decoded_ += char(0xC0 | (c >> 6));
+            this->decoded_ += char(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000) {
+            this->decoded_ += char(0xE0 | (c >> 12));
+            this->decoded_ += char(0x80 | ((c >> 6) & 0x3F));
+            this->decoded_ += char(0x80 | (c & 0x3F));
+        }
+        else {
+            this->decoded_ += char(0xF0 | (c >> 18));
+            this->decoded_ += char(0x80 | ((c >> 12) & 0x3F));
+            this->decoded_ += char(0x80 | ((c >> 6) & 0x3F));
+            this->decoded_ += char(0x80 | (c & 0x3F));
+        }
+    }
+
+    inline unsigned long parse_hex() {
+        if (this->end_ - this->p_ < 4) {
+            this->fail();
+        }
+
+        unsigned long c = 0;
+        for (int n = 0; n < 4; ++n) {
+            char const h = *this->p_++;
+            c <<= 4;
+                 if (h >= '0' && h <= '9') c |= h - '0';
+            else if (h >= 'a' && h <= 'f') c |= h - 'a' + 10;
+            else if (h >= 'A' && h <= 'F') c |= h - 'A' + 10;
+            else this->fail();
+        }
+        return c;
+    }
+
+    inline void parse_literal(char const* const literal, kind_type const kind, bool const boolean) {
+        std::size_t const n = std::strlen(literal);
+        if (static_cast<std::size_t>(this->end_ - this->p_) < n || std::memcmp(this->p_, literal, n) != 0) {
+            this->fail();
+        }
+        this->p_ += n;
+        std::size_t const i = this->push(kind);
+        this->nodes_[i].boolean = boolean;
+    }
+
+    inline void parse_number() {
+        char const* const begin = this->p_;
+        bool integral = true;
+
+        if (this->p_ != this->end_ && *this->p_ == '-') ++this->p_;
+        char const* const digits = this->p_;
+        if (!this->skip_digits()) this->fail();
+        if (*digits == '0' && this->p_ - digits > 1) this->fail(); // No leading zeros.
+        if (this->p_ != this->end_ && *this->p_ == '.') {
+            ++this->p_;
+            integral = false;
+            if (!this->skip_digits()) this->fail();
+        }
+        if (this->p_ != this->end_ && (*this->p_ == 'e' || *this->p_ == 'E')) {
+            ++this->p_;
+            integral = false;
+            if (this->p_ != this->end_ && (*this->p_ == '+' || *this->p_ == '-')) ++this->p_;
+            if (!this->skip_digits()) this->fail();
+        }
+
+        // The text needn't be null-terminated (e.g. when mapped), so the number is copied first.
+        std::string const number(begin, this->p_);
+        std::size_t const i = this->push(integer_kind);
+        node& n = this->nodes_[i];
+        n.offset = index_type(begin - this->data_);
+        n.size   = index_type(this->p_ - begin);
+        errno    = 0;
+
+        if (integral) {
+            long long const integer = std::strtoll(number.c_str(), 0, 10);
+            if (errno != ERANGE) {
+                n.integer = integer;
+                return;
+            }
+        }
+        else {
+            double const floating = std::strtod(number.c_str(), 0);
+            if (errno != ERANGE || (floating != HUGE_VAL && floating != -HUGE_VAL)) {
+                n.kind     = floating_kind;
+                n.floating = floating;
+                return;
+            }
+        }
+
+        n.kind = string_kind;
+    }
+
+    // Builds an object's hash table, once all of its members are known.
+    inline void index(std::size_t const i) {
+        node& object = this->nodes_[i];
+        if (object.size == 0) {
+            return;
+        }
+
+        std::size_t const mask   = capacity(object.size) - 1;
+        std::size_t const offset = this->slots_.size();
+        this->slots_.resize(offset + mask + 1, 0);
+        object.offset = index_type(offset);
+
+        for (std::size_t k = this->first(i); k != this->last(i); k = this->next(this->next(k))) {
+            std::size_t slot = hash(this->chars(k), this->size(k)) & mask;
+
+            for (;; slot = (slot + 1) & mask) {
+                index_type& existing = this->slots_[offset + slot];
+                if (existing == 0 || (this->size(existing) == this->size(k) &&
+                        std::memcmp(this->chars(existing), this->chars(k), this->size(k)) == 0)) {
+                    existing = index_type(k); // Later duplicates win.
+                    break;
+                }
+            }
+        }
+    }
+
+    inline std::size_t push(kind_type const kind) {
+        node n;
+        n.kind     = static_cast<unsigned char>(kind);
+        n.escaped  = false;
+        n.size     = 0;
+        n.offset   = 0;
+        n.end      = index_type(this->nodes_.size() + 1);
+        n.integer  = 0;
+        this->nodes_.push_back(n);
+        return this->nodes_.size() - 1;
+    }
+
+    inline void skip_space() {
+        while (this->p_ != this->end_ && (*this->p_ == ' ' || *this->p_ == '\t' || *this->p_ == '\n' || *this->p_ == '\r')) {
+            ++this->p_;
+        }
+    }
+
+    inline bool skip_digits() {
+        char const* const begin = this->p_;
+        while (this->p_ != this->end_ && *this->p_ >= '0' && *this->p_ <= '9') {
+            ++this->p_;
+        }
+        return this->p_ != begin;
+    }
+
+    inline bool accept(char const c) {
+        this->skip_space();
+        if (this->p_ != this->end_ && *this->p_ == c) {
+            ++this->p_;
+            return true;
+        }
+        return false;
+    }
+
+    inline void expect(char const c) {
+        if (!this->accept(c)) {
+            this->fail();
+        }
+    }
+
+    inline void fail() const {
+        std::size_t const n = (std::min)(std::size_t(this->end_ - this->p_), std::size_t(32));
+        AJG_SYNTH_THROW(parsing_error(std::string(this->p_, n)));
+    }
+
+  private:
+
+    boost::shared_ptr<file_contents const> contents_;
+    std::string                            text_;
+    std::string                            decoded_;
+    std::vector<node>                      nodes_;
+    std::vector<index_type>                slots_;
+    char const*                            data_;
+    char const*                            p_;
+    char const*                            end_;
+};
+
+}}} // namespace ajg::synth::detail
+
+#endif // AJG_SYNTH_DETAIL_JSON_HPP_INCLUDED
@@ -0,0 +1,123 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_DETAIL_SPACELESS_STREAMBUF_HPP_INCLUDED
+#define AJG_SYNTH_DETAIL_SPACELESS_STREAMBUF_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <ios>
+#include <string>
+#include <streambuf>
+
+#include <boost/noncopyable.hpp>
+
+namespace ajg {
+namespace synth {
+namespace detail {
+
+//
+// spaceless_streambuf:
+//     Forwards everything written to it to another streambuf, except for whitespace between a
+//     '>' and a '<', which is dropped as it goes by. Only such gaps are ever buffered, so output
+//     is produced in a single pass; finish() must be called to flush any trailing whitespace.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <class Char, class Traits = std::char_traits<Char> >
+struct spaceless_streambuf : std::basic_streambuf<Char, Traits>, boost::noncopyable {
+  public:
+
+    typedef Char                                                                char_type;
+    typedef Traits                                                              traits_type;
+    typedef typename traits_type::int_type                                      int_type;
+    typedef std::basic_streambuf<char_type, traits_type>                        streambuf_type;
+    typedef std::basic_string<char_type, traits_type>                           string_type;
+
+  public:
+
+    explicit spaceless_streambuf(streambuf_type* const target)
+        : target_(target), after_tag_(false), in_gap_(false) {}
+
+  public:
+
+    inline bool finish() {
+        bool const written = this->in_gap_ ? this->write(this->gap_.data(), this->gap_.size()) : true;
+        this->gap_.clear();
+        this->in_gap_ = false;
+        return written;
+    }
+
+  protected:
+
+    virtual int_type overflow(int_type const c) {
+        if (traits_type::eq_int_type(c, traits_type::eof())) {
+            return traits_type::not_eof(c);
+        }
+        char_type const ch = traits_type::to_char_type(c);
+        return this->xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+    }
+
+    virtual std::streamsize xsputn(char_type const* const s, std::streamsize const n) {
+        char_type const*       run = s; // Start of the current run of characters to pass through.
+        char_type const* const end = s + n;
+
+        for (char_type const* p = s; p != end; ++p) {
+            char_type const c = *p;
+
+            if (this->in_gap_) {
+                if (is_space(c)) {
+                    this->gap_ += c;
+                    continue;
+                }
+                else if (c != char_type('<') && !this->write(this->gap_.data(), this->gap_.size())) {
+                    return 0;
+                }
+                this->gap_.clear();
+                this->in_gap_ = false;
+                run = p;
+            }
+            else if (this->after_tag_ && is_space(c)) {
+                if (!this->write(run, p - run)) {
+                    return 0;
+                }
+                this->gap_ += c;
+                this->in_gap_ = true;
+                continue;
+            }
+
+            this->after_tag_ = c == char_type('>');
+        }
+
+        if (!this->in_gap_ && !this->write(run, end - run)) {
+            return 0;
+        }
+        return n;
+    }
+
+    virtual int sync() {
+        return this->target_->pubsync();
+    }
+
+  private:
+
+    inline static bool is_space(char_type const c) {
+        return c == char_type(' ')  || c == char_type('\t') || c == char_type('\n')
+            || c == char_type('\v') || c == char_type('\f') || c == char_type('\r');
+    }
+
+    inline bool write(char_type const* const s, std::streamsize const n) {
+        return n == 0 || this->target_->sputn(s, n) == n;
+    }
+
+  private:
+
+    streambuf_type* const target_;
+    bool                  after_tag_;
+    bool                  in_gap_;
+    string_type           gap_;
+};
+
+}}} // namespace ajg::synth::detail
+
+#endif // AJG_SYNTH_DETAIL_SPACELESS_STREAMBUF_HPP_INCLUDED
@@ -0,0 +1,106 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_DETAIL_STRING_STREAMBUF_HPP_INCLUDED
+#define AJG_SYNTH_DETAIL_STRING_STREAMBUF_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <ios>
+#include <string>
+#include <streambuf>
+
+#include <boost/noncopyable.hpp>
+
+namespace ajg {
+namespace synth {
+namespace detail {
+
+//
+// string_streambuf:
+//     Appends everything written to it to a string, which (unlike with an ostringstream) can be
+//     reserved ahead of time and taken afterwards without copying it. Single characters go into a
+//     small put area first, which is appended whenever it fills up, is synced, or is destroyed;
+//     the string is only complete once one of those happens.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <class Char, class Traits = std::char_traits<Char> >
+struct string_streambuf : std::basic_streambuf<Char, Traits>, boost::noncopyable {
+  public:
+
+    typedef Char                                                                char_type;
+    typedef Traits                                                              traits_type;
+    typedef typename traits_type::int_type                                      int_type;
+    typedef typename traits_type::pos_type                                      pos_type;
+    typedef typename traits_type::off_type                                      off_type;
+    typedef std::basic_string<char_type, traits_type>                           string_type;
+
+  public:
+
+    explicit string_streambuf(string_type& string) : string_(string) {
+        this->setp(this->area_, this->area_ + area_size);
+    }
+
+    ~string_streambuf() {
+        this->flush_area();
+    }
+
+  protected:
+
+    virtual int_type overflow(int_type const c) {
+        this->flush_area();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *this->pptr() = traits_type::to_char_type(c);
+            this->pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual std::streamsize xsputn(char_type const* const s, std::streamsize const n) {
+        if (n <= this->epptr() - this->pptr()) {
+            traits_type::copy(this->pptr(), s, static_cast<std::size_t>(n));
+            this->pbump(static_cast<int>(n));
+        }
+        else {
+            this->flush_area();
+            this->string_.append(s, static_cast<std::size_t>(n));
+        }
+        return n;
+    }
+
+    virtual int sync() {
+        this->flush_area();
+        return 0;
+    }
+
+    // Only reports the current position (i.e. tellp), since there's nothing to seek within.
+    virtual pos_type seekoff(off_type const off, std::ios_base::seekdir const dir, std::ios_base::openmode const which) {
+        if (off != 0 || dir != std::ios_base::cur || !(which & std::ios_base::out)) {
+            return pos_type(off_type(-1));
+        }
+        return pos_type(off_type(this->string_.size() + (this->pptr() - this->pbase())));
+    }
+
+  private:
+
+    inline void flush_area() {
+        if (this->pptr() != this->pbase()) {
+            this->string_.append(this->pbase(), this->pptr());
+            this->setp(this->area_, this->area_ + area_size);
+        }
+    }
+
+  private:
+
+    static std::size_t const area_size = 256;
+
+  private:
+
+    string_type& string_;
+    char_type    area_[area_size];
+};
+
+}}} // namespace ajg::synth::detail
+
+#endif // AJG_SYNTH_DETAIL_STRING_STREAMBUF_HPP_INCLUDED
@@ -10,6 +10,7 @@
 #include <locale>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -19,6 +20,7 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/classification.hpp>
+#include <boost/type_traits/make_unsigned.hpp>
 
 #include <ajg/synth/exceptions.hpp>
 
@@ -85,35 +87,172 @@ struct text {
 
 
 //
-// uri_encode
+// charset:
+//     A lookup table of which ASCII characters an escaper can output as they are; non-ASCII
+//     characters are either all clean or all escaped. Clean runs are then copied in bulk.
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    inline static string_type uri_encode(string_type const& string) {
-        sstream_type ss;
+  private:
+
+    typedef typename boost::make_unsigned<char_type>::type                      unsigned_type;
+
+    struct charset {
+      public:
+
+        explicit charset(boolean_type const clean) : others_(clean) {
+            std::fill(this->ascii_, this->ascii_ + 128, clean);
+        }
+
+      public:
+
+        inline charset& with(char const* s, boolean_type const clean) {
+            for (; *s; ++s) this->ascii_[static_cast<unsigned char>(*s) & 0x7F] = clean;
+            return *this;
+        }
+
+        inline charset& below(unsigned const limit, boolean_type const clean) {
+            std::fill(this->ascii_, this->ascii_ + limit, clean);
+            return *this;
+        }
 
+        inline boolean_type operator()(char_type const c) const {
+            unsigned_type const u = static_cast<unsigned_type>(c);
+            return u < 128 ? this->ascii_[u] : this->others_;
+        }
+
+      private:
+
+        boolean_type ascii_[128];
+        boolean_type others_;
+    };
+
+    inline static char const* alphanumerics() {
+        return "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    }
+
+    template <class Stream>
+    inline static void escape_into( Stream&            stream
+                                  , string_type const& string
+                                  , charset     const& clean
+                                  , void (*const escape)(Stream&, char_type)
+                                  ) {
+        char_type const*       run = string.data();
+        char_type const* const end = run + string.size();
+
+        for (char_type const* p = run; p != end; ++p) {
+            if (!clean(*p)) {
+                stream.write(run, p - run);
+                escape(stream, *p);
+                run = p + 1;
+            }
+        }
+
+        stream.write(run, end - run);
+    }
+
+    inline static string_type escape( string_type const& string
+                                    , charset     const& clean
+                                    , void (*const escape)(sstream_type&, char_type)
+                                    ) {
         for (auto const& c : string) {
-            boolean_type const allowed = (std::isalnum)(c) || c == '_' || c == '-' || c == '.' || c == '/';
-            allowed ? ss << c : ss << "%" << hexize(c, 2);
+            if (!clean(c)) {
+                sstream_type ss;
+                escape_into(ss, string, clean, escape);
+                AJG_SYNTH_ASSERT(ss);
+                return ss.str();
+            }
         }
+        return string; // Nothing to escape.
+    }
 
-        AJG_SYNTH_ASSERT(ss);
-        return ss.str();
+    template <class Stream>
+    inline static void write_hex(Stream& stream, char_type const c, size_type const width) {
+        static char const digits[] = "0123456789ABCDEF";
+        char_type buffer[2 * sizeof(unsigned_type) + 4];
+        unsigned_type u = static_cast<unsigned_type>(c);
+        size_type n = 0;
+
+        do {
+            buffer[n++] = char_type(digits[u & 0xF]);
+        } while ((u >>= 4) != 0);
+
+        while (n < width) {
+            buffer[n++] = char_type('0');
+        }
+
+        while (n != 0) {
+            stream.put(buffer[--n]);
+        }
+    }
+
+    template <class Stream> inline static void percent_escape(Stream& stream, char_type const c) { stream.put(char_type('%')); write_hex(stream, c, 2); }
+    template <class Stream> inline static void control_escape(Stream& stream, char_type const c) { stream << "\\x"; write_hex(stream, c, 2); }
+
+    template <class Stream>
+    inline static void entity_escape(Stream& stream, char_type const c) {
+        switch (c) {
+        case char_type('<'):  stream << "&lt;";   break;
+        case char_type('>'):  stream << "&gt;";   break;
+        case char_type('&'):  stream << "&amp;";  break;
+        case char_type('"'):  stream << "&quot;"; break;
+        case char_type('\''): stream << "&apos;"; break;
+        default: stream << "&#x"; write_hex(stream, c, 4);
+        }
     }
 
+    template <class Stream>
+    inline static void slash_escape(Stream& stream, char_type const c) {
+        stream.put(char_type('\\'));
+        stream.put(c);
+    }
+
+    inline static charset const& uri_charset() {
+        static charset const clean = charset(false).with(alphanumerics(), true).with("_-./", true);
+        return clean;
+    }
+
+    inline static charset const& iri_charset() {
+        static charset const clean = charset(false).with(alphanumerics(), true).with("/#%[]=:;$&()+,!?", true);
+        return clean;
+    }
+
+    inline static charset const& controls_charset() {
+        static charset const clean = charset(true).below(32, false);
+        return clean;
+    }
+
+    inline static charset const& entities_charset(boolean_type const ascii) {
+        static charset const clean = charset(true).with("<>&\"'", false);
+        static charset const none  = charset(false);
+        return ascii ? none : clean;
+    }
+
+    inline static charset const& slashes_charset() {
+        static charset const clean = charset(true).with("\\'\"", false);
+        return clean;
+    }
+
+  public:
+
 //
-// iri_encode
+// uri_encode
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    inline static string_type iri_encode(string_type const& string) {
-        sstream_type ss;
+    inline static string_type uri_encode(string_type const& string) {
+        return escape(string, uri_charset(), &percent_escape<sstream_type>);
+    }
 
-        for (auto const& c : string) {
-            boolean_type const allowed = (std::isalnum)(c) || boost::algorithm::is_any_of("/#%[]=:;$&()+,!?")(c);
-            allowed ? ss << c : ss << "%" << hexize(c, 2);
-        }
+    template <class Stream>
+    inline static void uri_encode_into(Stream& stream, string_type const& string) {
+        escape_into(stream, string, uri_charset(), &percent_escape<Stream>);
+    }
 
-        AJG_SYNTH_ASSERT(ss);
-        return ss.str();
+//
+// iri_encode
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline static string_type iri_encode(string_type const& string) {
+        return escape(string, iri_charset(), &percent_escape<sstream_type>);
     }
 
 //
@@ -122,15 +261,7 @@ struct text {
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
     inline static string_type escape_controls(string_type const& string) {
-        sstream_type ss;
-
-        for (auto const& c : string) {
-            boolean_type const allowed = c >= 32;
-            allowed ? ss << c : ss << "\\x" << hexize(c, 2);
-        }
-
-        AJG_SYNTH_ASSERT(ss);
-        return ss.str();
+        return escape(string, controls_charset(), &control_escape<sstream_type>);
     }
 
 //
@@ -140,21 +271,23 @@ struct text {
     inline static string_type escape_entities( string_type  const& string
                                              , boolean_type const  ascii = false
                                              ) {
-        sstream_type ss;
+        return escape(string, entities_charset(ascii), &entity_escape<sstream_type>);
+    }
 
-        for (auto const& c : string) {
-            switch (c) {
-            case char_type('<'):  ss << "&lt;";   break;
-            case char_type('>'):  ss << "&gt;";   break;
-            case char_type('&'):  ss << "&amp;";  break;
-            case char_type('"'):  ss << "&quot;"; break;
-            case char_type('\''): ss << "&apos;"; break;
-            default: ascii ? ss << "&#x" << hexize(c, 4) : ss << c;
-            }
-        }
+    template <class Stream>
+    inline static void escape_entities_into( Stream&             stream
+                                           , string_type  const& string
+                                           , boolean_type const  ascii = false
+                                           ) {
+        escape_into(stream, string, entities_charset(ascii), &entity_escape<Stream>);
+    }
 
-        AJG_SYNTH_ASSERT(ss);
-        return ss.str();
+//
+// escape_slashes
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline static string_type escape_slashes(string_type const& string) {
+        return escape(string, slashes_charset(), &slash_escape<sstream_type>);
     }
 
 //
@@ -269,6 +402,25 @@ struct text {
         return algo::ends_with(s, suffix);
     }
 
+//
+// iequals:
+//     Whether a string equals a lowercase (ASCII) literal, regardless of the former's case; unlike
+//     comparing against lower(s) and literal(...), it doesn't copy either one.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline static boolean_type iequals(string_type const& s, char const* const lowercase) {
+        std::locale const& locale = std::locale::classic();
+        size_type i = 0;
+
+        for (; i < s.size(); ++i) {
+            if (lowercase[i] == '\0' || std::tolower(s[i], locale) != char_type(lowercase[i])) {
+                return false;
+            }
+        }
+
+        return lowercase[i] == '\0';
+    }
+
 //
 // lower
 ////////////////////////////////////////////////////////////////////////////////////////////////////
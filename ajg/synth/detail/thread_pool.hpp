@@ -0,0 +1,113 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_DETAIL_THREAD_POOL_HPP_INCLUDED
+#define AJG_SYNTH_DETAIL_THREAD_POOL_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <deque>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+#include <boost/noncopyable.hpp>
+
+namespace ajg {
+namespace synth {
+namespace detail {
+
+//
+// thread_pool:
+//     A fixed set of worker threads that run the tasks submitted to it in order, each yielding a
+//     future for its result. Since the workers are reused, so is any per-thread state (e.g. caches.)
+//     NOTE: Tasks mustn't wait on other tasks, lest every worker end up waiting.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct thread_pool : boost::noncopyable {
+  public:
+
+    typedef std::function<void()>                                               task_type;
+
+  public:
+
+    explicit thread_pool(std::size_t const size) : stopping_(false) {
+        for (std::size_t i = 0; i < size; ++i) {
+            this->workers_.push_back(std::thread(&thread_pool::work, this));
+        }
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> const lock(this->mutex_);
+            this->stopping_ = true;
+        }
+        this->pending_.notify_all();
+
+        for (auto& worker : this->workers_) {
+            worker.join();
+        }
+    }
+
+  public:
+
+    template <class Function>
+    std::future<typename std::result_of<Function()>::type> submit(Function const& function) {
+        typedef typename std::result_of<Function()>::type result_type;
+        auto const task = std::make_shared<std::packaged_task<result_type()> >(function);
+        {
+            std::lock_guard<std::mutex> const lock(this->mutex_);
+            this->tasks_.push_back([task] { (*task)(); });
+        }
+        this->pending_.notify_one();
+        return task->get_future();
+    }
+
+    inline std::size_t size() const { return this->workers_.size(); }
+
+    // One worker per core, started on first use.
+    inline static thread_pool& shared() {
+        // FIXME: Destroy at program end to avoid leak.
+        static thread_pool* const pool = new thread_pool((std::max)(std::thread::hardware_concurrency(), 1u));
+        return *pool;
+    }
+
+  private:
+
+    void work() {
+        for (;;) {
+            task_type task;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex_);
+                while (!this->stopping_ && this->tasks_.empty()) {
+                    this->pending_.wait(lock);
+                }
+                if (this->tasks_.empty()) {
+                    return;
+                }
+                task = std::move(this->tasks_.front());
+                this->tasks_.pop_front();
+            }
+            task(); // NOTE: packaged_task captures any exception in the future.
+        }
+    }
+
+  private:
+
+    std::mutex               mutex_;
+    std::condition_variable  pending_;
+    std::deque<task_type>    tasks_;
+    std::vector<std::thread> workers_;
+    bool                     stopping_;
+};
+
+}}} // namespace ajg::synth::detail
+
+#endif // AJG_SYNTH_DETAIL_THREAD_POOL_HPP_INCLUDED
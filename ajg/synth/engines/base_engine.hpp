@@ -121,13 +121,14 @@ struct base_engine<Traits>::base_kernel : boost::noncopyable {
         // TODO: Invoke set_furthest in some (maybe all) the derived engine regexes (like markers)
         //       to present more precise error message lines.
         typename x::function<set_furthest_iterator>::type const set_furthest = {{}};
+        typename x::function<take_step_>::type const take_step = {{}};
 
         this->plain = +(~x::before(this->skipper) >> _);
 
         // block = skip(plain[...])(*tag[...]); // Using skip is slightly slower than this:
         this->block = *x::keep // Causes actions (i.e. furthest) to execute eagerly.
-            ( x::ref(this->tag)   [set_furthest(*this->_state, _)]
-            | x::ref(this->plain) [set_furthest(*this->_state, _)]
+            ( x::nil[x::check(take_step(*this->_state))] >> x::ref(this->tag) [set_furthest(*this->_state, _)]
+            | (x::ref(this->plain)[x::check(take_step(*this->_state, _))])     [set_furthest(*this->_state, _)]
             );
     }
 
@@ -193,6 +194,7 @@ struct base_engine<Traits>::base_kernel : boost::noncopyable {
 
     inline void parse(state_type* state) const { // Pointer to make clear it's mutable.
         state->match().let(this->_state = state);
+        state->start_budget();
 
         if (!x::regex_match(state->begin(), state->end(), state->match(), this->block)) {
             // On failure, throw a semi-informative exception.
@@ -203,6 +205,37 @@ struct base_engine<Traits>::base_kernel : boost::noncopyable {
         AJG_SYNTH_ASSERT(state->consumed());
     }
 
+  protected:
+
+//
+// take_step_:
+//     A functor that takes a step within the state's parse budget, throwing once it runs out; parse
+//     steps are taken by matching `x::nil[x::check(take_step(*_state))]`, which matches nothing, or
+//     one per character by checking `regex[x::check(take_step(*_state, _))]`, so that (re)scanning
+//     a run of text costs as much as the run is long.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    struct take_step_ {
+        typedef boolean_type result_type;
+
+        boolean_type operator()(state_type& state) const {
+            return this->take(state, 1);
+        }
+
+        boolean_type operator()(state_type& state, sub_match_type const& match) const {
+            return this->take(state, static_cast<size_type>(match.length()));
+        }
+
+      private:
+
+        boolean_type take(state_type& state, size_type const steps) const {
+            if (char const* const reason = state.take_step(steps)) {
+                AJG_SYNTH_THROW(parsing_error(text::narrow(state.line(error_line_limit)), reason));
+            }
+            return true;
+        }
+    };
+
   AJG_SYNTH_IF_MSVC(public, protected):
 
     regex_type tag;
@@ -7,6 +7,8 @@
 
 #include <map>
 #include <deque>
+#include <atomic>
+#include <vector>
 #include <utility>
 
 #include <boost/function.hpp>
@@ -54,6 +56,7 @@ struct context : boost::noncopyable {
     typedef typename traits_type::timezone_type                                 timezone_type;
     typedef typename traits_type::string_type                                   string_type;
     typedef typename traits_type::symbols_type                                  symbols_type;
+    typedef typename traits_type::path_type                                     path_type;
     typedef typename traits_type::paths_type                                    paths_type;
     typedef typename traits_type::names_type                                    names_type;
     typedef typename traits_type::language_type                                 language_type;
@@ -76,6 +79,14 @@ struct context : boost::noncopyable {
     }                                                                           metadata_type;
     typedef void const*                                                         match_type;
     typedef boost::function<void(ostream_type&, context_type&)>                 block_type;
+    typedef std::map<string_type, std::vector<block_type> >                     overrides_type;
+    typedef struct inheritance {
+        boolean_type   derived;   // Whether the template extends another.
+        block_type     root;      // Renders the outermost ancestor, once resolved.
+        overrides_type overrides; // Blocks of the template and of its resolved ancestors.
+
+        inheritance() : derived(false) {}
+    }                                                                           inheritance_type;
     typedef boost::optional<value_type>                                         change_type;
 
   private:
@@ -89,7 +100,7 @@ struct context : boost::noncopyable {
   public:
 
     inline explicit context(data_type const& data, metadata_type const& metadata = metadata_type())
-        : data_(data), metadata_(metadata) {}
+        : data_(data), metadata_(metadata), overrides_(0), level_(0), dependencies_(0) {}
 
   public:
 
@@ -103,6 +114,8 @@ struct context : boost::noncopyable {
     inline data_type const& data() const { return this->data_; }
     inline data_type        data(data_type data) { std::swap(data, this->data_); return data; }
 
+    inline metadata_type const& metadata() const { return this->metadata_; }
+
     inline boolean_type caseless() const { return this->metadata_.caseless; }
     inline boolean_type caseless(boolean_type caseless) { std::swap(caseless, this->metadata_.caseless); return caseless; }
 
@@ -121,6 +134,12 @@ struct context : boost::noncopyable {
     inline boolean_type localized() const { return this->metadata_.localized; }
     inline boolean_type localized(boolean_type localized) { std::swap(localized, this->metadata_.localized); return localized; }
 
+    // The time as of the start of the current render, so that every use of it agrees.
+    inline time_type now() const { return this->snapshot_ ? *this->snapshot_ : traits_type::utc_time(); }
+
+    inline boost::optional<time_type> snapshot() const { return this->snapshot_; }
+    inline boost::optional<time_type> snapshot(boost::optional<time_type> snapshot) { std::swap(snapshot, this->snapshot_); return snapshot; }
+
     inline formats_type formats() const { return this->metadata_.formats; }
     inline void         formats(formats_type const& formats) {
         for (auto const& format : formats) {
@@ -157,6 +176,62 @@ struct context : boost::noncopyable {
         this->blocks_[name].push_back(block);
     }
 
+    inline boolean_type has_blocks() const {
+        for (auto const& pair : this->blocks_) {
+            if (!pair.second.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline overrides_type const* overrides() const { return this->overrides_; }
+    inline overrides_type const* overrides(overrides_type const* overrides) { std::swap(overrides, this->overrides_); return overrides; }
+
+    inline size_type level() const { return this->level_; }
+    inline size_type level(size_type level) { std::swap(level, this->level_); return level; }
+
+    // Per-render state of an engine's own (e.g. the innermost loop being rendered, or the captures
+    // of the last regular expression matched), one pointer per type, so that it needn't be known
+    // here; like the other setters, setting a slot returns what it held, to be restored after.
+    template <class T>
+    inline T* slot() const {
+        size_type const i = slot_index<T>();
+        return i < this->slots_.size() ? static_cast<T*>(this->slots_[i]) : 0;
+    }
+
+    template <class T>
+    inline T* slot(T* const value) {
+        size_type const i = slot_index<T>();
+        if (i >= this->slots_.size()) {
+            this->slots_.resize(i + 1, 0);
+        }
+        T* const previous = static_cast<T*>(this->slots_[i]);
+        this->slots_[i] = const_cast<void*>(static_cast<void const*>(value));
+        return previous;
+    }
+
+    // Where to record the files read while rendering, if anywhere.
+    inline paths_type* dependencies() const { return this->dependencies_; }
+    inline paths_type* dependencies(paths_type* dependencies) { std::swap(dependencies, this->dependencies_); return dependencies; }
+
+    inline void add_dependency(path_type const& path) {
+        if (this->dependencies_ && !detail::contains(path, *this->dependencies_)) {
+            this->dependencies_->push_back(path);
+        }
+    }
+
+    inline block_type const* get_override(string_type const& name, size_type const level) const {
+        if (this->overrides_) {
+            typename overrides_type::const_iterator const it = this->overrides_->find(name);
+
+            if (it != this->overrides_->end() && level < it->second.size()) {
+                return &it->second[level];
+            }
+        }
+        return 0;
+    }
+
     inline match_type get_match() const {
         AJG_SYNTH_ASSERT(!this->matches_.empty());
         match_type const match = this->matches_.top();
@@ -209,6 +284,17 @@ struct context : boost::noncopyable {
 
   private:
 
+    template <class T>
+    inline static size_type slot_index() {
+        static size_type const index = next_slot_index()++;
+        return index;
+    }
+
+    inline static std::atomic<size_type>& next_slot_index() {
+        static std::atomic<size_type> next(0);
+        return next;
+    }
+
     inline key_type cased(key_type const& original) const {
         if (!this->caseless()) {
             return original;
@@ -233,6 +319,13 @@ struct context : boost::noncopyable {
     matches_type  matches_;
     cycles_type   cycles_;
     changes_type  changes_;
+
+    overrides_type const* overrides_;
+    size_type             level_;
+    paths_type*           dependencies_;
+    std::vector<void*>    slots_;
+
+    boost::optional<time_type> snapshot_;
 };
 
 template <class Context>
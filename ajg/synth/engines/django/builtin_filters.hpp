@@ -211,24 +211,7 @@ struct builtin_filters {
                                         , context_type&         context
                                         ) {
             with_arity<0>::validate(arguments.first.size());
-            return escape_slashes(value).mark_safe();
-        }
-
-        inline static value_type escape_slashes(value_type const& value) {
-            string_type const string = value.to_string();
-            string_stream_type ss;
-
-            for (auto const& c : string) {
-                switch (c) {
-                case char_type('\''): ss << "\\'";  break;
-                case char_type('"'):  ss << "\\\""; break;
-                case char_type('\\'): ss << "\\\\"; break;
-                default: ss << c;
-                }
-            }
-
-            AJG_SYNTH_ASSERT(ss);
-            return ss.str();
+            return value_type(text::escape_slashes(value.to_string())).mark_safe();
         }
     };
 
@@ -504,15 +487,12 @@ struct builtin_filters {
                                         ) {
             with_arity<0, 1>::validate(arguments.first.size());
             // Get the number and the decimal places.
-            string_stream_type stream;
             integer_type  const n = arguments.first.empty() ? -1 : arguments.first[0].to_integer();
             floating_type const f = value.to_floating();
 
             // If it's an integer and n < 0, we don't want decimals.
             integer_type const precision = (n < 0 && !detail::has_fraction(f)) ? 0 : (std::abs)(n);
-            stream << std::fixed << std::setprecision(precision) << f;
-
-            return value_type(stream.str()).mark_safe();
+            return value_type(traits_type::format_fixed(f, static_cast<int>(precision))).mark_safe();
         }
     };
 
@@ -1091,6 +1071,13 @@ struct builtin_filters {
                                         ) {
             with_arity<1>::validate(arguments.first.size());
             string_type const spec = arguments.first[0].to_string();
+
+            // Plain conversions of plain numbers don't need the full formatting machinery.
+            if (spec.size() == 1 && value.is_numeric() && !value.is_textual()) {
+                if (spec[0] == char_type('s') || (value.is_integral() && (spec[0] == char_type('d') || spec[0] == char_type('i')))) {
+                    return value.to_string();
+                }
+            }
             return (format_type(char_type('%') + spec) % value).str();
         }
     };
@@ -1147,7 +1134,7 @@ struct builtin_filters {
             with_arity<0, 1>::validate(arguments.first.size());
             datetime_type const to   = value.to_datetime();
             datetime_type const from = arguments.first.empty() ?
-                traits_type::local_datetime(context.timezone()) :
+                traits_type::local_datetime(context.timezone(), context.now()) :
                 arguments.first[0].to_datetime(context.timezone());
             return value_type(formatter_type::format_duration(from - to)).mark_safe();
         }
@@ -1168,7 +1155,7 @@ struct builtin_filters {
             with_arity<0, 1>::validate(arguments.first.size());
             datetime_type const to   = value.to_datetime();
             datetime_type const from = arguments.first.empty() ?
-                traits_type::local_datetime(context.timezone()) :
+                traits_type::local_datetime(context.timezone(), context.now()) :
                 arguments.first[0].to_datetime(context.timezone());
             return value_type(formatter_type::format_duration(to - from)).mark_safe();
         }
@@ -1473,7 +1460,7 @@ struct builtin_filters {
                     for (size_type i = 0; i < size; ++i) {
                         value_type const& value = item[i];
                         ostream << indent << "<li>";
-                        Safe ? ostream << value : ostream << value.escape();
+                        Safe ? void(ostream << value) : value.escape(ostream);
 
                         if (++i < size) {
                             value_type const& next = item[i];
@@ -1485,7 +1472,7 @@ struct builtin_filters {
                             }
                             else {
                                 ostream << "</li>" << std::endl << indent << "<li>";
-                                Safe ? ostream << next : ostream << next.escape();
+                                Safe ? void(ostream << next) : next.escape(ostream);
                             }
                         }
 
@@ -1495,7 +1482,7 @@ struct builtin_filters {
             }
             else {
                 ostream << indent << "<li>";
-                Safe ? ostream << item : ostream << item.escape();
+                Safe ? void(ostream << item) : item.escape(ostream);
                 ostream << "</li>" << std::endl;
             }
         }
@@ -6,14 +6,18 @@
 #define AJG_SYNTH_ENGINES_DJANGO_BUILTIN_TAGS_HPP_INCLUDED
 
 #include <map>
+#include <deque>
 #include <string>
 #include <locale>
+#include <vector>
+#include <future>
 #include <sstream>
 #include <iterator>
 #include <stdexcept>
 
 #include <boost/cstdint.hpp>
 #include <boost/optional.hpp>
+#include <boost/noncopyable.hpp>
 
 #include <ajg/synth/exceptions.hpp>
 #include <ajg/synth/adapters/map.hpp>
@@ -25,7 +29,11 @@
 #include <ajg/synth/adapters/variant.hpp>
 #include <ajg/synth/detail/text.hpp>
 #include <ajg/synth/detail/advance_to.hpp>
+#include <ajg/synth/detail/file_cache.hpp>
 #include <ajg/synth/detail/filesystem.hpp>
+#include <ajg/synth/detail/thread_pool.hpp>
+#include <ajg/synth/detail/digest_streambuf.hpp>
+#include <ajg/synth/detail/spaceless_streambuf.hpp>
 #include <ajg/synth/engines/django/formatter.hpp>
 
 namespace ajg {
@@ -70,6 +78,7 @@ struct builtin_tags {
     typedef typename traits_type::datetime_type                                 datetime_type;
     typedef typename traits_type::timezone_type                                 timezone_type;
     typedef typename traits_type::path_type                                     path_type;
+    typedef typename traits_type::paths_type                                    paths_type;
     typedef typename traits_type::url_type                                      url_type;
     typedef typename traits_type::names_type                                    names_type;
     typedef typename traits_type::symbols_type                                  symbols_type;
@@ -88,13 +97,21 @@ struct builtin_tags {
                             , ostream_type&       ostream
                             );
 
+    typedef void (*linker_type)( kernel_type const& kernel
+                               , state_type&        state
+                               , match_type  const& match
+                               );
+
   private:
 
     typedef std::map<id_type, tag_type>                                         tags_type;
+    typedef std::map<id_type, linker_type>                                      linkers_type;
     typedef std::basic_ostringstream<char_type>                                 string_stream_type;
     typedef formatter<options_type>                                             formatter_type;
 
     typedef typename context_type::block_type                                   block_type;
+    typedef typename context_type::overrides_type                               overrides_type;
+    typedef typename state_type::inheritance_type                               inheritance_type;
 
     typedef typename options_type::renderer_type                                renderer_type;
     typedef typename options_type::renderers_type                               renderers_type;
@@ -111,14 +128,14 @@ struct builtin_tags {
     inline void initialize(kernel_type& kernel) {
         kernel.tag
             = add(kernel, autoescape_tag::syntax(kernel),        autoescape_tag::render)
-            | add(kernel, block_tag::syntax(kernel),             block_tag::render)
+            | add(kernel, block_tag::syntax(kernel),             block_tag::render,    block_tag::link)
             | add(kernel, comment_tag::syntax(kernel),           comment_tag::render)
             | add(kernel, csrf_token_tag::syntax(kernel),        csrf_token_tag::render)
             | add(kernel, cycle_tag::syntax(kernel),             cycle_tag::render)
             | add(kernel, cycle_as_tag::syntax(kernel),          cycle_as_tag::render)
             | add(kernel, cycle_as_silent_tag::syntax(kernel),   cycle_as_silent_tag::render)
             | add(kernel, debug_tag::syntax(kernel),             debug_tag::render)
-            | add(kernel, extends_tag::syntax(kernel),           extends_tag::render)
+            | add(kernel, extends_tag::syntax(kernel),           extends_tag::render,  extends_tag::link)
             | add(kernel, filter_tag::syntax(kernel),            filter_tag::render)
             | add(kernel, firstof_tag::syntax(kernel),           firstof_tag::render)
             | add(kernel, for_tag::syntax(kernel),               for_tag::render)
@@ -127,7 +144,7 @@ struct builtin_tags {
             | add(kernel, ifchanged_tag::syntax(kernel),         ifchanged_tag::render)
             | add(kernel, ifequal_tag::syntax(kernel),           ifequal_tag::render)
             | add(kernel, ifnotequal_tag::syntax(kernel),        ifnotequal_tag::render)
-            | add(kernel, include_tag::syntax(kernel),           include_tag::render)
+            | add(kernel, include_tag::syntax(kernel),           include_tag::render,  include_tag::link)
             | add(kernel, include_with_tag::syntax(kernel),      include_with_tag::render)
             | add(kernel, include_with_only_tag::syntax(kernel), include_with_only_tag::render)
             | add(kernel, load_tag::syntax(kernel),              load_tag::render)
@@ -154,7 +171,13 @@ struct builtin_tags {
         return regex;
     }
 
-    tags_type tags_;
+    inline regex_type const& add(kernel_type& kernel, regex_type const& regex, tag_type const tag, linker_type const linker) {
+        linkers_[regex.regex_id()] = linker;
+        return add(kernel, regex, tag);
+    }
+
+    tags_type    tags_;
+    linkers_type linkers_;
 
   public:
 
@@ -167,6 +190,99 @@ struct builtin_tags {
         return it == tags_.end() ? 0 : it->second;
     }
 
+//
+// get_linker
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline linker_type get_linker(id_type const id) const {
+        typename linkers_type::const_iterator it = linkers_.find(id);
+        return it == linkers_.end() ? 0 : it->second;
+    }
+
+//
+// isolated
+//     Whether a tag only affects its own output (and the variables it scopes), such that it can be
+//     rendered apart from what surrounds it; includes are judged by what they include, elsewhere.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline boolean_type isolated(id_type const id) const {
+        tag_type const tag = this->get(id);
+        return tag != block_tag::render           // Blocks are resolved through the context.
+            && tag != cycle_tag::render           // Cycles are tracked through the context.
+            && tag != cycle_as_tag::render
+            && tag != cycle_as_silent_tag::render
+            && tag != extends_tag::render
+            && tag != ifchanged_tag::render       // Changes are tracked through the context.
+            && tag != include_tag::render
+            && tag != ssi_tag::render
+            && tag != url_tag::render             // Resolvers may not be thread-safe.
+            && tag != url_as_tag::render
+            && tag != library_tag::render;        // Neither may library tags.
+    }
+
+//
+// render_apart
+//     Renders a block on the shared pool, with a context of its own that starts out with a copy of
+//     the given variables, yielding its output along with the files it read. Whatever is rendered
+//     apart doesn't render anything apart itself, lest the pool's workers wait on each other.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    typedef std::map<string_type, value_type>                                   variables_type;
+    typedef std::pair<string_type, paths_type>                                  rendered_type;
+
+    inline static std::future<rendered_type> render_apart( block_type     const& block
+                                                         , variables_type const& variables
+                                                         , context_type   const& context
+                                                         ) {
+        return detail::thread_pool::shared().submit(boost::bind(&builtin_tags::render_detached,
+            block, variables, context.metadata(), context.snapshot()));
+    }
+
+    inline static variables_type copy_variables(context_type const& context) {
+        variables_type variables;
+        for (auto const& key : context.keys()) {
+            if (attribute_type const attribute = context.get(key)) {
+                variables[key.to_string()] = *attribute;
+            }
+        }
+        return variables;
+    }
+
+    // Whether this thread is rendering something apart.
+    inline static boolean_type& detached() {
+        static AJG_SYNTH_THREAD_LOCAL boolean_type detached = false;
+        return detached;
+    }
+
+  private:
+
+    static rendered_type render_detached( block_type                             const& block
+                                        , variables_type                         const& variables
+                                        , typename context_type::metadata_type   const& metadata
+                                        , boost::optional<typename context_type::time_type> const& snapshot
+                                        ) {
+        rendered_type rendered;
+        context_type context(value_type(variables), metadata);
+        context.snapshot(snapshot);
+        context.dependencies(&rendered.second);
+
+        string_stream_type stream;
+        stream.imbue(traits_type::standard_locale());
+        detached() = true;
+        try {
+            block(stream, context);
+        }
+        catch (...) {
+            detached() = false;
+            throw;
+        }
+        detached() = false;
+        rendered.first = stream.str();
+        return rendered;
+    }
+
+  public:
+
 // TODO[c++11]: Replace with function.
 #define TAG(content) kernel.block_open >> *_s >> content >> *_s >> kernel.block_close
 
@@ -227,6 +343,20 @@ struct builtin_tags {
                 AJG_SYNTH_THROW(std::invalid_argument("mismatched endblock tag for " + original));
             }
 
+            if (context.overrides()) { // Resolved ahead of time by extends_tag::link.
+                if (block_type const* const block = context.get_override(name, 0)) {
+                    string_type const previous_name  = context.current(name);
+                    size_type   const previous_level = context.level(0);
+                    (*block)(ostream, context);
+                    context.level(previous_level);
+                    context.current(previous_name);
+                }
+                else {
+                    kernel.render_block(ostream, options, state, body, context);
+                }
+                return;
+            }
+
             context.push_block(name, boost::bind(&kernel_type::render_block, &kernel,
                 _1, boost::ref(options), boost::ref(state), boost::ref(body), _2));
             if (ostream.rdbuf() == 0) return; // Coming from an extends_tag; no need to render.
@@ -243,6 +373,87 @@ struct builtin_tags {
 
             context.current(previous);
         }
+
+        // Renders just the named block, as overridden by the template's descendants (whose blocks
+        // are already pending in the context, if any) and ancestors, with the rest of the chain of
+        // definitions available to block.super.
+        static void render_named( kernel_type  const& kernel
+                                , options_type const& options
+                                , state_type   const& state
+                                , string_type  const& name
+                                , context_type&       context
+                                , ostream_type&       ostream
+                                ) {
+            inheritance_type const& inheritance = state.inheritance();
+
+            if (inheritance.root && !context.has_blocks()) { // Resolved ahead of time by link.
+                typename overrides_type::const_iterator const it = inheritance.overrides.find(name);
+                if (it == inheritance.overrides.end() || it->second.empty()) {
+                    AJG_SYNTH_THROW(std::invalid_argument("missing block " + text::narrow(name)));
+                }
+
+                overrides_type const* const previous_overrides = context.overrides(&inheritance.overrides);
+                string_type           const previous_name      = context.current(name);
+                size_type             const previous_level     = context.level(0);
+                it->second.front()(ostream, context);
+                context.level(previous_level);
+                context.current(previous_name);
+                context.overrides(previous_overrides);
+                return;
+            }
+
+            if (match_type const* const match = find(kernel, state.match(), name)) {
+                context.push_block(name, boost::bind(&kernel_type::render_block, &kernel,
+                    _1, boost::cref(options), boost::cref(state), boost::cref((*match)(kernel.block)), _2));
+            }
+
+            // Let the parent, if any, add its own definition and render the most derived one.
+            for (auto const& nested : state.match().nested_results()) {
+                if (kernel.is(nested, kernel.tag)) {
+                    match_type const& tag = kernel.unnest(nested);
+
+                    if (kernel.builtin_tags_.get(tag.regex_id()) == &extends_tag::render) {
+                        value_type const value = kernel.evaluate(options, state, tag(kernel.value), context);
+                        path_type  const path  = traits_type::to_path(value.to_string());
+                        typename kernel_type::linked_type const parent =
+                            parse_template<typename kernel_type::path_template_type>(path, options);
+                        context.add_dependency(parent->info().first);
+                        parent->render_block_to_stream(name, ostream, context);
+                        return;
+                    }
+                }
+            }
+
+            string_type const previous = context.current(name);
+            block_type  const block    = context.pop_block(name);
+            if (!block) {
+                AJG_SYNTH_THROW(std::invalid_argument("missing block " + text::narrow(name)));
+            }
+            block(ostream, context);
+            context.current(previous);
+
+            while (context.pop_block(name)) {} // Leave no definitions pending in the context.
+        }
+
+        // Finds the named block's definition anywhere within the match, without rendering anything.
+        static match_type const* find(kernel_type const& kernel, match_type const& match, string_type const& name) {
+            for (auto const& nested : match.nested_results()) {
+                if (kernel.builtin_tags_.get(nested.regex_id()) == &block_tag::render
+                        && nested(kernel.name, 0)[id].str() == name) {
+                    return &nested;
+                }
+                else if (match_type const* const found = find(kernel, nested, name)) {
+                    return found;
+                }
+            }
+            return 0;
+        }
+
+        static void link(kernel_type const& kernel, state_type& state, match_type const& match) {
+            string_type const name = match(kernel.name, 0)[id].str();
+            state.inheritance().overrides[name].push_back(boost::bind(&kernel_type::render_block, &kernel,
+                _1, boost::cref(state.options()), boost::cref(state), boost::cref(match(kernel.block)), _2));
+        }
     };
 
 //
@@ -412,13 +623,52 @@ struct builtin_tags {
                           , context_type&       context
                           , ostream_type&       ostream
                           ) {
-            value_type  const  value = kernel.evaluate(options, state, match(kernel.value), context);
-            string_type const  path  = value.to_string(); // TODO: Handle values that are templates.
-            match_type  const& body  = match(kernel.block);
+            inheritance_type const& inheritance = state.inheritance();
+
+            // Unless blocks are pending from a template that couldn't be linked, render the root
+            // ancestor directly, using the overrides resolved by link below.
+            if (inheritance.root && !context.has_blocks()) {
+                overrides_type const* const previous = context.overrides(&inheritance.overrides);
+                inheritance.root(ostream, context);
+                context.overrides(previous);
+                return;
+            }
+
+            block_type  const* linked = state.get_link(match);
+            string_type const  path   = linked ? string_type() : // TODO: Handle values that are templates.
+                kernel.evaluate(options, state, match(kernel.value), context).to_string();
+            match_type  const& body   = match(kernel.block);
 
+            overrides_type const* const previous = context.overrides(0);
             ostream_type null_stream(0); // Note: blocks_tag uses the fact that rdbuf == 0 here.
             kernel.render_block(null_stream, options, state, body, context);
-            kernel.render_path(ostream, options, state, path, context);
+            linked ? (*linked)(ostream, context) : kernel.render_path(ostream, options, state, path, context);
+            context.overrides(previous);
+        }
+
+        static void link(kernel_type const& kernel, state_type& state, match_type const& match) {
+            typedef typename kernel_type::path_template_type                    template_type;
+            typedef void (template_type::*render_type)(ostream_type&, context_type&) const;
+
+            inheritance_type& inheritance = state.inheritance();
+            inheritance.derived = true;
+
+            if (typename kernel_type::linked_type const parent = kernel.link_path(state, match)) {
+                inheritance_type const& ancestry = parent->inheritance();
+
+                if (ancestry.derived && !ancestry.root) {
+                    return; // An ancestor could not be linked.
+                }
+
+                // The block chains are ordered from most to least derived.
+                for (auto const& pair : ancestry.overrides) {
+                    std::vector<block_type>& blocks = inheritance.overrides[pair.first];
+                    blocks.insert(blocks.end(), pair.second.begin(), pair.second.end());
+                }
+
+                render_type const render = &template_type::render_to_stream;
+                inheritance.root = ancestry.derived ? ancestry.root : block_type(boost::bind(render, parent, _1, _2));
+            }
         }
     };
 
@@ -516,6 +766,25 @@ struct builtin_tags {
                 return;
             }
 
+            if (options.loop_concurrency == 1 || !state.is_isolated(match) || detached()) {
+                render_iterations(kernel, options, state, for_, variables, it, end, context, ostream);
+            }
+            else {
+                render_chunked(kernel, options, state, for_, variables, sequence_type(it, end), context, ostream);
+            }
+        }
+
+        template <class Iterator>
+        static void render_iterations( kernel_type  const& kernel
+                                     , options_type const& options
+                                     , state_type   const& state
+                                     , match_type   const& body
+                                     , names_type   const& variables
+                                     , Iterator            it
+                                     , Iterator     const  end
+                                     , context_type&       context
+                                     , ostream_type&       ostream
+                                     ) {
             size_type const n = variables.size();
             AJG_SYNTH_ASSERT(n > 0);
             stage<context_type> stage(context);
@@ -537,9 +806,70 @@ struct builtin_tags {
                     }
                 }
 
-                kernel.render_block(ostream, options, state, for_, context);
+                kernel.render_block(ostream, options, state, body, context);
+            }
+        }
+
+//
+// for_tag::render_chunked:
+//     Splits a long loop whose body is isolated into chunks, renders all but the first apart while
+//     the first is rendered in place, then writes the rest in order, as a serial loop would have.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+        static void render_chunked( kernel_type   const& kernel
+                                  , options_type  const& options
+                                  , state_type    const& state
+                                  , match_type    const& body
+                                  , names_type    const& variables
+                                  , sequence_type const& items
+                                  , context_type&        context
+                                  , ostream_type&        ostream
+                                  ) {
+            size_type const concurrency = options.loop_concurrency ? options.loop_concurrency : detail::thread_pool::shared().size() + 1;
+            size_type const chunks      = (std::min)(concurrency, items.size() / minimum_chunk());
+            size_type const size        = chunks ? items.size() / chunks : items.size();
+
+            if (chunks < 2) {
+                render_iterations(kernel, options, state, body, variables, items.begin(), items.end(), context, ostream);
+                return;
+            }
+
+            variables_type const copied = copy_variables(context);
+            std::vector<std::future<rendered_type> > chunked;
+
+            try {
+                for (size_type i = 1; i < chunks; ++i) {
+                    size_type const first = i * size;
+                    size_type const last  = i + 1 == chunks ? items.size() : first + size;
+
+                    chunked.push_back(render_apart([&, first, last](ostream_type& o, context_type& c) {
+                        render_iterations(kernel, options, state, body, variables, items.begin() + first, items.begin() + last, c, o);
+                    }, copied, context));
+                }
+
+                render_iterations(kernel, options, state, body, variables, items.begin(), items.begin() + size, context, ostream);
+
+                for (auto& chunk : chunked) {
+                    rendered_type const rendered = chunk.get();
+                    ostream << rendered.first;
+
+                    for (auto const& path : rendered.second) {
+                        context.add_dependency(path);
+                    }
+                }
+            }
+            catch (...) {
+                for (auto const& chunk : chunked) {
+                    if (chunk.valid()) {
+                        chunk.wait(); // They refer to the items, which are about to go away.
+                    }
+                }
+                throw;
             }
         }
+
+        // Fewer iterations than this aren't worth rendering apart.
+        inline static size_type minimum_chunk() { return 1000; }
     };
 
 //
@@ -608,16 +938,14 @@ struct builtin_tags {
 
             boost::optional<value_type> const value = context.change(&match);
 
-            if (match_type const& vals = match(kernel.values)) { // Compare variables.
-                // NOTE: The key is a string (rather than e.g. an int) presumably in case variables are repeated.
-                association_type values;
+            if (match_type const& vals = match(kernel.values)) { // Compare variables, in order.
+                sequence_type values;
 
                 for (auto const& val : kernel.select_nested(vals, kernel.value)) {
-                    string_type const s = text::strip(val.str());
-                    values[s] = kernel.evaluate(options, state, val, context);
+                    values.push_back(kernel.evaluate(options, state, val, context));
                 }
 
-                if (value && value->template as<association_type>() == values) {
+                if (value && value->template as<sequence_type>() == values) {
                     if (else_) {
                         kernel.render_block(ostream, options, state, else_, context);
                     }
@@ -627,22 +955,73 @@ struct builtin_tags {
                     kernel.render_block(ostream, options, state, if_, context);
                 }
             }
-            else { // No variables, compare contents.
-                string_stream_type ss;
-                kernel.render_block(ss, options, state, if_, context);
-                string_type const s = ss.str();
-
-                if (value && value->template as<string_type>() == s) {
+            else { // No variables, compare the contents, by digest first.
+                scratch_type scratch;
+                detail::digest_streambuf<char_type> buffer(scratch.get());
+                ostream_type stream(&buffer);
+                kernel.render_block(stream, options, state, if_, context);
+                digest_type const digest = buffer.digest();
+                string_type const& contents = buffer.scratch();
+
+                // NOTE: The previous contents are kept too, so that colliding digests can't hide a change.
+                if (value && value->template as<contents_type>().first == digest
+                          && value->template as<contents_type>().second == contents) {
                     if (else_) {
                         kernel.render_block(ostream, options, state, else_, context);
                     }
                 }
                 else {
-                    context.change(&match, s);
-                    ostream << s;
+                    context.change(&match, contents_type(digest, contents));
+                    ostream.write(contents.data(), contents.size());
                 }
             }
         }
+
+      private:
+
+        typedef typename detail::digest_streambuf<char_type>::digest_type      digest_type;
+        typedef std::pair<digest_type, string_type>                            contents_type;
+
+        // Scratch strings to render into, one per level of nesting, reused across iterations.
+        struct scratch_type : boost::noncopyable {
+          public:
+
+            scratch_type() : level_(level()++) {
+                if (strings().size() <= this->level_) {
+                    strings().resize(this->level_ + 1); // NOTE: Doesn't invalidate references.
+                }
+            }
+
+            ~scratch_type() {
+                string_type& string = this->get();
+                if (string.capacity() > max_capacity) {
+                    string_type().swap(string);
+                }
+                --level();
+            }
+
+            inline string_type& get() { return strings()[this->level_]; }
+
+          private:
+
+            static size_type const max_capacity = 64 * 1024;
+
+            inline static size_type& level() {
+                static AJG_SYNTH_THREAD_LOCAL size_type level = 0;
+                return level;
+            }
+
+            inline static std::deque<string_type>& strings() {
+                // FIXME: Destroy at program end to avoid leak.
+                static AJG_SYNTH_THREAD_LOCAL std::deque<string_type>* strings = 0;
+                if (strings == 0) strings = new std::deque<string_type>;
+                return *strings;
+            }
+
+          private:
+
+            size_type const level_;
+        };
     };
 
 //
@@ -711,6 +1090,9 @@ struct builtin_tags {
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
     struct include_tag {
+        typedef typename kernel_type::linked_type                               linked_type;
+        typedef std::map<void const*, std::shared_future<rendered_type> >       launched_type;
+
         static regex_type syntax(kernel_type& kernel) {
             return TAG(kernel.reserved("include") >> kernel.value >> *_s >>
                 !(kernel.keyword("with") >> kernel.arguments >> !(s1 = kernel.keyword("only"))));
@@ -723,12 +1105,26 @@ struct builtin_tags {
                           , context_type&       context
                           , ostream_type&       ostream
                           ) {
-            value_type  const  value = kernel.evaluate(options, state, match(kernel.value), context);
-            string_type const  path  = value.to_string();
-            match_type  const& args  = match(kernel.arguments);
+            if (launched_type* const l = launched()) {
+                typename launched_type::iterator const it = l->find(&match);
+                if (it != l->end()) {
+                    rendered_type const& rendered = it->second.get();
+                    ostream << rendered.first;
+
+                    for (auto const& path : rendered.second) {
+                        context.add_dependency(path);
+                    }
+                    return;
+                }
+            }
+
+            block_type  const* linked = state.get_link(match);
+            string_type const  path   = linked ? string_type() :
+                kernel.evaluate(options, state, match(kernel.value), context).to_string();
+            match_type  const& args   = match(kernel.arguments);
 
             if (!args) {
-                kernel.render_path(ostream, options, state, path, context);
+                linked ? (*linked)(ostream, context) : kernel.render_path(ostream, options, state, path, context);
                 return;
             }
 
@@ -743,7 +1139,103 @@ struct builtin_tags {
             for (auto const& argument : arguments.second) {
                 context.set(argument.first, argument.second);
             }
-            kernel.render_path(ostream, options, state, path, context);
+            linked ? (*linked)(ostream, context) : kernel.render_path(ostream, options, state, path, context);
+        }
+
+        // Notes, while the included template is at hand, whether what it renders is isolated; only
+        // linked includes are ever rendered apart, lest each render parse theirs all over again.
+        static void link(kernel_type const& kernel, state_type& state, match_type const& match) {
+            if (linked_type const t = kernel.link_path(state, match)) {
+                if (t->isolated()) {
+                    state.set_isolated(match);
+                }
+            }
+        }
+
+        // How many includes the block directly contains.
+        static size_type count(kernel_type const& kernel, match_type const& block) {
+            size_type includes = 0;
+            for (auto const& nested : block.nested_results()) {
+                if (kernel.is(nested, kernel.tag)
+                        && kernel.builtin_tags_.get(kernel.unnest(nested).regex_id()) == include_tag::render) {
+                    ++includes;
+                }
+            }
+            return includes;
+        }
+
+        // The includes started ahead of time for the block being rendered, if any.
+        inline static launched_type*& launched() {
+            static AJG_SYNTH_THREAD_LOCAL launched_type* launched = 0;
+            return launched;
+        }
+
+//
+// include_tag::launch:
+//     Starts rendering, on the shared pool, each include directly within a block that is isolated,
+//     with a copy of the variables as they'll be when it's reached, into a buffer of its own; the
+//     buffers are still written in order, as each include is rendered. Stops at the first sibling
+//     that isn't isolated, since it could change what follows. What's isolated is marked at parse
+//     time, so this only consults the marks; since only linked includes (i.e. with options.linking)
+//     are parsed ahead of time, unlinked ones are always rendered in turn.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+        inline static void launch( kernel_type   const& kernel
+                                 , options_type  const& options
+                                 , state_type    const& state
+                                 , match_type    const& block
+                                 , context_type&        context
+                                 , launched_type&       launched
+                                 ) {
+            size_type const limit = options.include_concurrency;
+
+            if (count(kernel, block) < 2) {
+                return; // Nothing to gain.
+            }
+
+            for (auto const& nested : block.nested_results()) {
+                if (limit != 0 && launched.size() >= limit) {
+                    return;
+                }
+                else if (kernel.is(nested, kernel.plain)) {
+                    continue;
+                }
+
+                match_type const& match = kernel.unnest(nested);
+                if (!kernel.is(nested, kernel.tag) || kernel.builtin_tags_.get(match.regex_id()) != include_tag::render) {
+                    if (state.is_isolated(nested)) {
+                        continue;
+                    }
+                    return;
+                }
+
+                block_type const* const linked = state.get_link(match);
+                if (!linked || !state.is_isolated(match)) {
+                    return;
+                }
+
+                try {
+                    variables_type variables;
+                    if (!match[s1].matched) {
+                        variables = copy_variables(context);
+                    }
+
+                    if (match_type const& args = match(kernel.arguments)) {
+                        arguments_type const& arguments = kernel.evaluate_arguments(options, state, args, context);
+                        if (!arguments.first.empty()) {
+                            return; // Leave the error to render time.
+                        }
+                        for (auto const& argument : arguments.second) {
+                            variables[argument.first] = argument.second;
+                        }
+                    }
+
+                    launched[&match] = render_apart(*linked, variables, context).share();
+                }
+                catch (std::exception const&) {
+                    return; // Leave the error to render time.
+                }
+            }
         }
     };
 
@@ -1016,8 +1508,14 @@ struct builtin_tags {
                           , ostream_type&       ostream
                           ) {
             string_type   const f        = kernel.extract_string(match(kernel.string_literal));
-            datetime_type const datetime = traits_type::local_datetime(context.timezone());
-            ostream << formatter_type::format_datetime(context.format_or(f, f), datetime);
+            string_type   const format   = context.format_or(f, f);
+            datetime_type const datetime = traits_type::local_datetime(context.timezone(), context.now());
+            if (options.coarse_clock) {
+                ostream << traits_type::format_clock(&formatter_type::format_datetime, format, context.timezone(), datetime);
+            }
+            else {
+                formatter_type::format_datetime(ostream, format, datetime);
+            }
         }
     };
 
@@ -1088,17 +1586,21 @@ struct builtin_tags {
                           , context_type&       context
                           , ostream_type&       ostream
                           ) {
-            static typename kernel_type::string_regex_type const tag = '<' >> *~(as_xpr('>')) >> '>';
-            static typename kernel_type::string_regex_type const gap = (s1 = tag) >> +_s >> (s2 = tag);
+            match_type const& body = match(kernel.block);
 
-            string_stream_type ss;
-            std::ostreambuf_iterator<char_type> it(ostream);
+            if (ostream.rdbuf() == 0) { // Coming from an extends_tag; nothing will be output anyway.
+                return kernel.render_block(ostream, options, state, body, context);
+            }
 
-            match_type const& body = match(kernel.block);
-            kernel.render_block(ss, options, state, body, context);
-            // TODO: Use bidirectional_input_stream to feed directly to regex_replace.
-            string_type const string = ss.str();
-            x::regex_replace(it, string.begin(), string.end(), gap, text::literal("$1$2"));
+            detail::spaceless_streambuf<char_type> buffer(ostream.rdbuf());
+            ostream_type spaceless(&buffer);
+            spaceless.copyfmt(ostream);
+
+            kernel.render_block(spaceless, options, state, body, context);
+
+            if (!buffer.finish() || !spaceless) {
+                ostream.setstate(std::ios_base::badbit);
+            }
         }
     };
 
@@ -1131,12 +1633,35 @@ struct builtin_tags {
                 kernel.render_path(ostream, options, state, path, context);
             }
             else {
-                string_type line;
-                std::string const path_ = text::narrow(path);
-                std::basic_ifstream<char_type> file(path_.c_str());
-                while (std::getline(file, line)) ostream << line << kernel.newline;
+                detail::file_caching const cached = file_caching_for(options.caching);
+                boost::shared_ptr<detail::file_contents const> contents;
+                context.add_dependency(path);
+
+                try {
+                    contents = detail::read_file_contents(text::narrow(path), cached);
+                }
+                catch (read_error const&) {
+                    return; // Unreadable files produce no output.
+                }
+
+                if (std::size_t const size = contents->size()) {
+                    write_raw(ostream, contents->data(), size);
+
+                    if (contents->data()[size - 1] != '\n') { // Lines are always terminated.
+                        ostream << kernel.newline;
+                    }
+                }
             }
         }
+
+        inline static void write_raw(std::basic_ostream<char>& ostream, char const* const data, std::size_t const size) {
+            ostream.write(data, static_cast<std::streamsize>(size));
+        }
+
+        template <class Ostream>
+        inline static void write_raw(Ostream& ostream, char const* const data, std::size_t const size) {
+            ostream << text::widen(std::string(data, size));
+        }
     };
 
 //
@@ -1258,13 +1783,25 @@ struct builtin_tags {
                         value = value.to_datetime(timezone);
                     }
                 }
-                safe ? ostream << value : ostream << value.escape();
+                safe ? void(ostream << value) : value.escape(ostream);
             }
             else { // Literal block.super.
                 // Note: block.super is an actual variable in Django, but using it as such (e.g.
                 //       to apply filters to it) seems like an extremely obscure corner case so it's
                 //       not supported for now; that permits rendering only out what's necessary.
-                if (block_type const& block = context.pop_block(context.current())) {
+                if (context.overrides()) { // Resolved ahead of time by extends_tag::link.
+                    size_type const level = context.level() + 1;
+
+                    if (block_type const* const block = context.get_override(context.current(), level)) {
+                        size_type const previous = context.level(level);
+                        (*block)(ostream, context);
+                        context.level(previous);
+                    }
+                    else {
+                        AJG_SYNTH_THROW(std::runtime_error("block.super at top level"));
+                    }
+                }
+                else if (block_type const& block = context.pop_block(context.current())) {
                     block(ostream, context);
                     context.push_block(context.current(), block);
                 }
@@ -1321,7 +1858,7 @@ struct builtin_tags {
                 / kernel.evaluate(options, state, limit, context).to_number()
                 * kernel.evaluate(options, state, width, context).to_number();
 
-            ostream << round(ratio);
+            traits_type::output_number(ostream, round(ratio));
         }
 
       private:
@@ -16,6 +16,7 @@
 #include <algorithm>
 
 #include <boost/ref.hpp>
+#include <boost/bind.hpp>
 #include <boost/optional.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/noncopyable.hpp>
@@ -23,6 +24,7 @@
 #include <ajg/synth/templates.hpp>
 #include <ajg/synth/exceptions.hpp>
 #include <ajg/synth/detail/drop.hpp>
+#include <ajg/synth/detail/find.hpp>
 #include <ajg/synth/detail/text.hpp>
 #include <ajg/synth/engines/base_engine.hpp>
 #include <ajg/synth/engines/django/builtin_tags.hpp>
@@ -50,6 +52,7 @@ struct engine : base_engine<Traits> {
     typedef typename traits_type::datetime_type                                 datetime_type;
     typedef typename traits_type::duration_type                                 duration_type;
     typedef typename traits_type::path_type                                     path_type;
+    typedef typename traits_type::paths_type                                    paths_type;
     typedef typename traits_type::string_type                                   string_type;
     typedef typename traits_type::url_type                                      url_type;
     typedef typename traits_type::symbols_type                                  symbols_type;
@@ -62,6 +65,7 @@ struct engine : base_engine<Traits> {
     typedef typename options_type::names_type                                   names_type;
     typedef typename options_type::arguments_type                               arguments_type;
     typedef typename options_type::renderer_type                                renderer_type;
+    typedef typename context_type::block_type                                   block_type;
 
     typedef typename value_type::sequence_type                                  sequence_type;
 
@@ -95,6 +99,8 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
 
     typedef builtin_tags<kernel_type>                                           builtin_tags_type;
     typedef builtin_filters<kernel_type>                                        builtin_filters_type;
+    typedef templates::path_template<engine_type>                               path_template_type;
+    typedef boost::shared_ptr<path_template_type const>                         linked_type;
     typedef std::map<string_type, string_type>                                  markers_type; // TODO[c++11]: unordered_map.
 
     typedef typename kernel_type::id_type                                       id_type;
@@ -124,6 +130,8 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
         , variable_open  (marker(text::literal("{{"), text::literal("openvariable")))
         , variable_close (marker(text::literal("}}"), text::literal("closevariable")))
         {
+        typename x::function<typename kernel_type::take_step_>::type const take_step = {{}};
+
 //
 // common grammar
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -221,10 +229,12 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
         nested_expression
             = as_xpr('(') >> *_s >> x::ref(expression) >> *_s >> ')'
             ;
-        expression
-            = unary_expression
-            | binary_expression
-            | nested_expression
+        expression // NOTE: Takes a parse step, since this is where most backtracking (re)starts.
+            = x::nil[x::check(take_step(*this->_state))]
+                >> ( unary_expression
+                   | binary_expression
+                   | nested_expression
+                   )
             ;
         variable_names
             // TODO: Check whether whitespace can precede or follow ','.
@@ -345,6 +355,126 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
         return names;
     }
 
+    boost::optional<string_type> extract_constant(match_type const& value) const {
+        // Only a lone string literal (i.e. without filters, links or operators) is constant.
+        match_type const& binary = this->unnest(this->unnest(value));
+
+        if (value.nested_results().size() == 1 && this->is(binary, this->binary_expression)
+                && binary.nested_results().size() == 1) {
+            match_type const& chain = this->unnest(binary);
+
+            if (chain.nested_results().size() == 1) {
+                match_type const& literal = this->unnest(this->unnest(chain));
+
+                if (this->is(literal, this->string_literal)) {
+                    return this->extract_string(literal);
+                }
+            }
+        }
+
+        return boost::none;
+    }
+
+//
+// parse
+//     Extends base_kernel::parse with an optional link step, which resolves constant paths
+//     ahead of time so that they needn't be looked up on every render.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void parse(state_type* state) const {
+        kernel_type::base_kernel_type::parse(state);
+
+        if (state->options().linking) {
+            this->link_match(*state, state->match());
+        }
+
+        if (state->options().loop_concurrency != 1 || state->options().include_concurrency != 1) {
+            this->mark_isolated(*state, state->match());
+
+            if (this->isolated(state->options(), *state, state->match())) {
+                state->set_isolated(state->match()); // For those that include this template.
+            }
+        }
+    }
+
+    // Marks, once and for all, what can be rendered apart: loops whose bodies are isolated, so
+    // that their iterations can be, and the isolated siblings of includes in blocks with several,
+    // so that those includes can be started ahead; the includes themselves are marked as linked.
+    void mark_isolated(state_type& state, match_type const& match) const {
+        typedef typename builtin_tags_type::for_tag     for_tag;
+        typedef typename builtin_tags_type::include_tag include_tag;
+
+        for (auto const& nested : match.nested_results()) {
+            this->mark_isolated(state, nested);
+        }
+
+        if (state.options().loop_concurrency != 1 && builtin_tags_.get(match.regex_id()) == for_tag::render
+                && this->isolated(state.options(), state, match(this->block, 0))) {
+            state.set_isolated(match);
+        }
+        else if (state.options().include_concurrency != 1 && include_tag::count(*this, match) >= 2) {
+            for (auto const& nested : match.nested_results()) {
+                if (this->is(nested, this->tag) && builtin_tags_.get(this->unnest(nested).regex_id()) == include_tag::render) {
+                    continue;
+                }
+                else if (this->isolated(state.options(), state, nested)) {
+                    state.set_isolated(nested);
+                }
+            }
+        }
+    }
+
+    void link_match(state_type& state, match_type const& match) const {
+        // NOTE: Nested matches are linked first (e.g. so that blocks precede their extends_tag.)
+        for (auto const& nested : match.nested_results()) {
+            this->link_match(state, nested);
+        }
+
+        if (typename builtin_tags_type::linker_type const linker = builtin_tags_.get_linker(match.regex_id())) {
+            linker(*this, state, match);
+        }
+    }
+
+    linked_type link_path(state_type& state, match_type const& match) const {
+        typedef void (path_template_type::*render_type)(ostream_type&, context_type&) const;
+
+        boost::optional<string_type> const constant = this->extract_constant(match(this->value));
+        if (!constant) return linked_type(); // The path won't be known until render time.
+
+        path_type const path    = traits_type::to_path(*constant);
+        paths_type&     linking = kernel_type::linking_paths();
+        if (detail::contains(path, linking)) return linked_type(); // Recursive; leave it to render time.
+
+        linked_type linked;
+        linking.push_back(path);
+        try {
+            render_type const render = &path_template_type::render_to_stream;
+            linked = parse_template<path_template_type>(path, state.options());
+            state.set_link(match, boost::bind(render, linked, _1, _2));
+            state.add_dependency(linked->info().first, linked->info().second);
+
+            for (auto const& dependency : linked->dependencies()) {
+                state.add_dependency(dependency.first, dependency.second);
+            }
+        }
+        catch (read_error const&) {
+            // The file may not exist yet; leave it to render time.
+        }
+        catch (...) {
+            linking.pop_back();
+            throw;
+        }
+        linking.pop_back();
+        return linked;
+    }
+
+    inline static paths_type& linking_paths() {
+        // FIXME: Destroy at program end to avoid leak.
+        static AJG_SYNTH_THREAD_LOCAL paths_type* paths = 0;
+        if (paths == 0) paths = new paths_type;
+        return *paths;
+    }
+
     void render( ostream_type&       ostream
                , options_type const& options
                , state_type   const& state
@@ -371,7 +501,23 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
                     , path_type    const& path
                     , context_type&       context
                     ) const {
-        parse_template<templates::path_template<engine_type> > (path, options)->render_to_stream(ostream, context);
+        typedef templates::path_template<engine_type> template_type;
+        boost::shared_ptr<template_type const> const t = parse_template<template_type>(path, options);
+        context.add_dependency(t->info().first);
+
+        for (auto const& dependency : t->dependencies()) {
+            context.add_dependency(dependency.first);
+        }
+        t->render_to_stream(ostream, context);
+    }
+
+    void render_named_block( ostream_type&       ostream
+                           , options_type const& options
+                           , state_type   const& state
+                           , string_type  const& name
+                           , context_type&       context
+                           ) const {
+        builtin_tags_type::block_tag::render_named(*this, options, state, name, context, ostream);
     }
 
     void render_plain( ostream_type&       ostream
@@ -389,9 +535,63 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
                      , match_type   const& block
                      , context_type&       context
                      ) const {
-        for (auto const& nested : block.nested_results()) {
-            this->render_match(ostream, options, state, nested, context);
+        typedef typename builtin_tags_type::include_tag include_tag;
+
+        if (options.include_concurrency == 1 || builtin_tags_type::detached()) {
+            for (auto const& nested : block.nested_results()) {
+                this->render_match(ostream, options, state, nested, context);
+            }
+            return;
+        }
+
+        typename include_tag::launched_type launched;
+        include_tag::launch(*this, options, state, block, context, launched);
+
+        typename include_tag::launched_type* const previous = include_tag::launched();
+        include_tag::launched() = &launched;
+        try {
+            for (auto const& nested : block.nested_results()) {
+                this->render_match(ostream, options, state, nested, context);
+            }
+        }
+        catch (...) {
+            include_tag::launched() = previous;
+
+            for (auto const& l : launched) {
+                l.second.wait(); // Their variables may refer to data that's about to go away.
+            }
+            throw;
+        }
+        include_tag::launched() = previous;
+    }
+
+    // Whether the match can be rendered apart from what surrounds it, given the variables as they
+    // are when it's reached; anything that can't be told ahead of time is assumed not to be.
+    boolean_type isolated(options_type const& options, state_type const& state, match_type const& match) const {
+        typedef typename builtin_tags_type::include_tag include_tag;
+
+        if (this->is(match, this->tag)) {
+            match_type const& m = this->unnest(match);
+
+            if (builtin_tags_.get(m.regex_id()) == include_tag::render) {
+                if (!state.is_isolated(m)) { // i.e. Unless linked to an isolated template.
+                    return false;
+                }
+            }
+            else if (!builtin_tags_.isolated(m.regex_id())) {
+                return false;
+            }
+        }
+        else if (this->is(match, this->filter) && state.get_filter(match(this->name)[id].str())) {
+            return false; // Library filters may not be thread-safe.
+        }
+
+        for (auto const& nested : match.nested_results()) {
+            if (!this->isolated(options, state, nested)) {
+                return false;
+            }
         }
+        return true;
     }
 
     void render_tag( ostream_type&       ostream
@@ -6,11 +6,10 @@
 #define AJG_SYNTH_ENGINES_DJANGO_FORMATTER_HPP_INCLUDED
 
 #include <map>
-#include <sstream>
+#include <vector>
 
 #include <boost/array.hpp>
 #include <boost/function.hpp>
-#include <boost/assign/list_of.hpp>
 
 #include <ajg/synth/detail/text.hpp>
 
@@ -45,6 +44,7 @@ struct formatter {
     typedef typename traits_type::duration_type                                 duration_type;
     typedef typename traits_type::timezone_type                                 timezone_type;
     typedef typename traits_type::string_type                                   string_type;
+    typedef typename traits_type::ostream_type                                  ostream_type;
 
     typedef typename value_type::range_type                                     range_type;
     typedef typename value_type::sequence_type                                  sequence_type;
@@ -56,354 +56,388 @@ struct formatter {
   private:
 
 ///
-/// native_flags:
-///     The flag specifiers native to Boost.DateTime.
+/// native_flag:
+///     The flag specifiers native to Boost.DateTime that the Django ones are built from.
 ///     See [http://www.boost.org/doc/html/date_time/date_time_io.html#date_time.format_flags]
+///     The numeric ones are computed directly, unless the datetime is special (e.g. infinite.)
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    struct native_flags {
-        static size_type const size = 31;
-        // NOTE:
-        //   - Fields marked [#] are not used because their availability is platform-dependent.
-        //   - Fields marked [*] are not used because Windows is garbage and barfs otherwise.
-
-        // Date flags:
-        string_type a;
-        string_type A;
-        string_type b;
-        string_type B;
-        string_type c;
-     // string_type C; [#]
-        string_type d;
-     // string_type D; [#]
-     // string_type e; [#]
-     // string_type g; [*]
-        string_type G;
-     // string_type h; [#]
-        string_type j;
-        string_type m;
-     // string_type u; [*]
-        string_type U;
-     // string_type V; [#]
-        string_type w;
-        string_type W;
-        string_type x;
-        string_type y;
-        string_type Y;
-
-        // Time flags:
-        string_type f;
-        string_type F;
-        string_type H;
-        string_type I;
-     // string_type k; [*]
-     // string_type l; [*]
-        string_type M;
-     // string_type O; [*]
-        string_type p;
-     // string_type P; [#]
-     // string_type r; [#]
-        string_type R;
-        string_type s;
-        string_type S;
-        string_type T;
-        string_type q;
-        string_type Q;
-        string_type X;
-        string_type z;
-        string_type Z;
-        string_type ZP;
-
-        inline static native_flags from_datetime(datetime_type datetime) {
-            static std::vector<string_type> const format_flags = boost::assign::list_of<string_type>
-                (text::literal("%a"))
-                (text::literal("%A"))
-                (text::literal("%b"))
-                (text::literal("%B"))
-                (text::literal("%c"))
-                (text::literal("%d"))
-                (text::literal(AJG_SYNTH_IF_WINDOWS("%y", "%G"))) // TODO: Find workaround for Windows.
-                (text::literal("%j"))
-                (text::literal("%m"))
-                (text::literal("%U"))
-                (text::literal("%w"))
-                (text::literal("%W"))
-                (text::literal("%x"))
-                (text::literal("%y"))
-                (text::literal("%Y"))
-                (text::literal("%f"))
-                (text::literal("%F"))
-                (text::literal("%H"))
-                (text::literal("%I"))
-                (text::literal("%M"))
-                (text::literal("%p"))
-                (text::literal("%R"))
-                (text::literal("%s"))
-                (text::literal("%S"))
-                (text::literal("%T"))
-                (text::literal("%q"))
-                (text::literal("%Q"))
-                (text::literal("%X"))
-                (text::literal("%z"))
-                (text::literal("%Z"))
-                (text::literal("%ZP"))
-                ;
-
-            static string_type const format_string     = text::join(format_flags, text::literal("|"));
-            string_type const formatted_string         = traits_type::format_datetime(format_string, datetime);
-            std::vector<string_type> const& specifiers = text::split(formatted_string, text::literal("|"), native_flags::size);
-            AJG_SYNTH_ASSERT(specifiers.size() == native_flags::size);
-
-            native_flags const flags =
-                { specifiers[0]
-                , specifiers[1]
-                , specifiers[2]
-                , specifiers[3]
-                , specifiers[4]
-                , specifiers[5]
-                , specifiers[6]
-                , specifiers[7]
-                , specifiers[8]
-                , specifiers[9]
-                , specifiers[10]
-                , specifiers[11]
-                , specifiers[12]
-                , specifiers[13]
-                , specifiers[14]
-                , specifiers[15]
-                , specifiers[16]
-                , specifiers[17]
-                , specifiers[18]
-                , specifiers[19]
-                , specifiers[20]
-                , specifiers[21]
-                , specifiers[22]
-                , specifiers[23]
-                , specifiers[24]
-                , specifiers[25]
-                , specifiers[26]
-                , specifiers[27]
-                , specifiers[28]
-                , specifiers[29]
-                , specifiers[30]
-                };
-            return flags;
+    enum native_flag
+        { native_a, native_A, native_b, native_B, native_d, native_G, native_j, native_m, native_w, native_y
+        , native_Y, native_f, native_H, native_I, native_M, native_p, native_S, native_T, native_z
+        , native_count
+        };
+
+    typedef unsigned long                                                       natives_mask_type;
+    typedef boost::array<string_type, native_count>                             natives_type;
+
+    inline static natives_mask_type bit(native_flag const flag) { return natives_mask_type(1) << flag; }
+
+    inline static natives_mask_type computed_natives() {
+        return bit(native_d) | bit(native_j) | bit(native_m) | bit(native_w) | bit(native_y)
+             | bit(native_Y) | bit(native_H) | bit(native_I) | bit(native_M) | bit(native_S)
+             | bit(native_T);
+    }
+
+    inline static string_type const& native_specifier(size_type const i) {
+        static boost::array<string_type, native_count> const specifiers =
+            {{ text::literal("%a")
+             , text::literal("%A")
+             , text::literal("%b")
+             , text::literal("%B")
+             , text::literal("%d")
+             , text::literal(AJG_SYNTH_IF_WINDOWS("%y", "%G")) // TODO: Find workaround for Windows.
+             , text::literal("%j")
+             , text::literal("%m")
+             , text::literal("%w")
+             , text::literal("%y")
+             , text::literal("%Y")
+             , text::literal("%f")
+             , text::literal("%H")
+             , text::literal("%I")
+             , text::literal("%M")
+             , text::literal("%p")
+             , text::literal("%S")
+             , text::literal("%T")
+             , text::literal("%z")
+             }};
+        return specifiers[i];
+    }
+
+///
+/// dependencies:
+///     The native flags that each Django flag is derived from.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline static natives_mask_type dependencies(char_type const flag) {
+        switch (flag) {
+        case char_type('a'): return bit(native_p);
+        case char_type('A'): return bit(native_p);
+        case char_type('b'): return bit(native_b);
+        case char_type('c'): return bit(native_Y) | bit(native_m) | bit(native_d) | bit(native_H) | bit(native_M) | bit(native_S);
+        case char_type('d'): return bit(native_d);
+        case char_type('D'): return bit(native_a);
+        case char_type('e'): return bit(native_z);
+        case char_type('E'): return bit(native_B);
+        case char_type('f'): return bit(native_p) | bit(native_I) | bit(native_H) | bit(native_M);
+        case char_type('F'): return bit(native_B);
+        case char_type('g'): return bit(native_I);
+        case char_type('G'): return bit(native_H);
+        case char_type('h'): return bit(native_I);
+        case char_type('H'): return bit(native_H);
+        case char_type('i'): return bit(native_M);
+        case char_type('j'): return bit(native_d);
+        case char_type('l'): return bit(native_A);
+        case char_type('m'): return bit(native_m);
+        case char_type('M'): return bit(native_b);
+        case char_type('n'): return bit(native_m);
+        case char_type('N'): return bit(native_b);
+        case char_type('o'): return bit(native_G);
+        case char_type('P'): return bit(native_p) | bit(native_I) | bit(native_H) | bit(native_M);
+        case char_type('r'): return bit(native_a) | bit(native_d) | bit(native_b) | bit(native_Y) | bit(native_T);
+        case char_type('s'): return bit(native_S);
+        case char_type('u'): return bit(native_f);
+        case char_type('w'): return bit(native_w);
+        case char_type('y'): return bit(native_y);
+        case char_type('Y'): return bit(native_Y);
+        case char_type('z'): return bit(native_j);
+        default:             return 0;
         }
-    };
+    }
+
+    inline static boolean_type is_flag(char_type const c) {
+        static string_type const flags = text::literal("aAbBcdDeEfFgGhHiIjlLmMnNoOPrsStTuUwWyYzZ");
+        return flags.find(c) != string_type::npos;
+    }
 
 ///
-/// cooked_flags:
-///     The flag specifiers used by Django.
+/// program:
+///     A format string compiled into the literals and flags it consists of, along with the natives
+///     they need; only those are ever computed when it is run.
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    struct cooked_flags {
-        string_type a;
-        string_type A;
-        string_type b;
-        string_type B;
-        string_type c;
-        string_type d;
-        string_type D;
-        string_type e;
-        string_type E;
-        string_type f;
-        string_type F;
-        string_type g;
-        string_type G;
-        string_type h;
-        string_type H;
-        string_type i;
-        string_type I;
-        string_type j;
-        string_type l;
-        string_type L;
-        string_type m;
-        string_type M;
-        string_type n;
-        string_type N;
-        string_type o;
-        string_type O;
-        string_type P;
-        string_type r;
-        string_type s;
-        string_type S;
-        string_type t;
-        string_type T;
-        string_type u;
-        string_type U;
-        string_type w;
-        string_type W;
-        string_type y;
-        string_type Y;
-        string_type z;
-        string_type Z;
-
-        inline static cooked_flags cook_flags(native_flags const& flags, datetime_type const& datetime) {
-            date_type     const date        = traits_type::to_date(datetime);
-            timezone_type const timezone    = traits_type::to_timezone(datetime);
-            size_type     const day         = static_cast<size_type>(date.day());
-            size_type     const year        = static_cast<size_type>(date.year());
-            size_type     const iso_week    = static_cast<size_type>(date.week_number());
-            size_type     const month_days  = static_cast<size_type>(date.end_of_month().day());
-            boolean_type  const is_am       = flags.p == text::literal("AM");
-            boolean_type  const is_pm       = flags.p == text::literal("PM");
-            boolean_type  const has_minutes = flags.M != text::literal("00");
-            boolean_type  const is_midnight = flags.H == text::literal("00") && !has_minutes;
-            boolean_type  const is_noon     = flags.H == text::literal("12") && !has_minutes;
-            boolean_type  const is_leapyear = ((year & 3) == 0 && ((year % 25) != 0 || (year & 15) == 0));
-            boolean_type  const is_dst      = traits_type::is_dst(datetime);
-            duration_type const offset      = traits_type::to_duration_at(timezone, datetime);
-            integer_type  const offset_secs = static_cast<integer_type>(offset.total_seconds());
-            string_type   const meridiem    = is_am ? text::literal("a.m.")
-                                            : is_pm ? text::literal("p.m.")
-                                            : string_type();
-            string_type   const succint     = text::trim_leading_zeros(flags.I)
-                                            + (has_minutes ? char_type(':') + flags.M : string_type());
-            string_type   const informal    = is_midnight ? text::literal("midnight")
-                                            : is_noon     ? text::literal("noon")
-                                            : (succint + char_type(' ') + meridiem);
-            string_type   const iso_offset  = traits_type::to_boolean(timezone) ? stringify(offset, true) : string_type();
-            string_type   const iso8601     = flags.Y + char_type('-')
-                                            + flags.m + char_type('-')
-                                            + flags.d + char_type('T')
-                                            + flags.H + char_type(':')
-                                            + flags.M + char_type(':')
-                                            + flags.S
-                                            + iso_offset;
-            string_type   const rfc_offset  = stringify(offset, false);
-            string_type   const rfc2822     = flags.a + text::literal(", ")
-                                            + flags.d + char_type(' ')
-                                            + flags.b + char_type(' ')
-                                            + flags.Y + char_type(' ')
-                                            + flags.T + char_type(' ')
-                                            + rfc_offset;
-
-         // time_type     const utc_epoch   = traits_type::to_time(std::time_t(0));
-            time_type     const utc_epoch   = traits_type::to_time(traits_type::to_date(1970, 1, 1));
-            duration_type const since_epoch = traits_type::to_utc_time(datetime) - utc_epoch;
-            timezone_type const machine_tz  = traits_type::machine_timezone();
-            datetime_type const machine_dt  = traits_type::local_datetime(machine_tz);
-            size_type     const unix_stamp  = static_cast<size_type>(since_epoch.seconds());
-
-            cooked_flags cooked;
-            cooked.a = meridiem;
-            cooked.A = flags.p;
-            cooked.b = text::lower(flags.b);
-            cooked.B = string_type(); // NOTE: "Not implemented" per the spec.
-            cooked.c = iso8601;
-            cooked.d = flags.d;
-            cooked.D = flags.a;
-            cooked.e = flags.z; // XXX: Compare against traits_type::to_string_at(timezone, datetime);
-            cooked.E = flags.B; // TODO: Make locale-aware.
-            cooked.f = informal;
-            cooked.F = flags.B;
-            cooked.g = text::trim_leading_zeros(flags.I);
-            cooked.G = text::trim_leading_zeros(flags.H);
-            cooked.h = flags.I;
-            cooked.H = flags.H;
-            cooked.i = flags.M;
-            cooked.I = text::literal(is_dst ? "1" : "0");
-            cooked.j = text::trim_leading_zeros(flags.d);
-            cooked.l = flags.A;
-            cooked.L = text::literal(is_leapyear ? "True" : "False");
-            cooked.m = flags.m;
-            cooked.M = flags.b;
-            cooked.n = text::trim_leading_zeros(flags.m);
-            cooked.N = flags.b; // TODO: Use A.P. style.
-            cooked.o = flags.G;
-            cooked.O = rfc_offset;
-            cooked.P = informal;
-            cooked.r = rfc2822;
-            cooked.s = flags.S;
-            cooked.S = ordinal_suffix(static_cast<int>(day));
-            cooked.t = text::stringize(month_days);
-            cooked.T = traits_type::to_string_at(machine_tz, machine_dt);
-            cooked.u = text::trim_left(flags.f, text::literal("."));
-            cooked.U = text::stringize(unix_stamp);
-            cooked.w = flags.w;
-            cooked.W = text::stringize(iso_week);
-            cooked.y = flags.y;
-            cooked.Y = flags.Y;
-            cooked.z = text::trim_leading_zeros(flags.j);
-            cooked.Z = text::stringize(offset_secs);
-            return cooked;
+    struct program {
+        struct instruction {
+            char_type   flag; // Zero for literals.
+            string_type literal;
+        };
+
+        std::vector<instruction> instructions;
+        natives_mask_type        natives;
+        std::vector<size_type>   formatted;   // The natives Boost.DateTime produces for regular datetimes.
+        string_type              format;      // The Boost.DateTime format string for those, joined by '|'.
+        std::vector<size_type>   all;         // The same for special datetimes...
+        string_type              all_format;  // ...which Boost.DateTime produces in their entirety.
+    };
+
+    typedef std::map<string_type, program>                                      programs_type;
+
+    inline static program compile(string_type const& format) {
+        program p;
+        p.natives = 0;
+
+        // TODO: This might not be UTF8-safe; consider using a utf8_iterator.
+        for (auto const& c : format) {
+            if (is_flag(c)) {
+                typename program::instruction const i = { c, string_type() };
+                p.instructions.push_back(i);
+                p.natives |= dependencies(c);
+            }
+            else if (!p.instructions.empty() && p.instructions.back().flag == 0) {
+                p.instructions.back().literal += c;
+            }
+            else {
+                typename program::instruction const i = { 0, string_type(1, c) };
+                p.instructions.push_back(i);
+            }
+        }
+
+        for (size_type i = 0; i < native_count; ++i) {
+            if (p.natives & bit(native_flag(i))) {
+                if (!(computed_natives() & bit(native_flag(i)))) {
+                    p.format += (p.formatted.empty() ? string_type() : text::literal("|")) + native_specifier(i);
+                    p.formatted.push_back(i);
+                }
+                p.all_format += (p.all.empty() ? string_type() : text::literal("|")) + native_specifier(i);
+                p.all.push_back(i);
+            }
         }
+        return p;
+    }
 
-        inline static string_type stringify(duration_type const& offset, boolean_type const colon) {
-            return (offset.is_negative() ? char_type('-') : char_type('+'))
-                 + (text::digitize(static_cast<size_type>(offset.hours()), 2))
-                 + (colon ? text::literal(":") : string_type())
-                 + (text::digitize(static_cast<size_type>(offset.minutes()), 2))
-                 ;
+    inline static program const& compiled(string_type const& format) {
+        // FIXME: Destroy at program end to avoid leak.
+        static AJG_SYNTH_THREAD_LOCAL programs_type* programs = 0;
+        if (programs == 0) programs = new programs_type;
+
+        typename programs_type::const_iterator const it = programs->find(format);
+        if (it != programs->end()) {
+            return it->second;
+        }
+        else if (programs->size() >= max_programs) { // Formats can come from data, so keep this bounded.
+            programs->clear();
         }
+        return (*programs)[format] = compile(format);
+    }
 
-        inline static string_type ordinal_suffix(int const n) {
-            AJG_SYNTH_ASSERT(n > 0 && n <= 31);
-            switch (n) {
-            case 1: case 21: return text::literal("st");
-            case 2: case 22: return text::literal("nd");
-            case 3: case 23: return text::literal("rd");
-            default:         return text::literal("th");
+    static size_type const max_programs = 256;
+
+///
+/// load_natives:
+///     Computes the natives needed by a program, in at most one pass through Boost.DateTime.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline static void load_natives(program const& p, natives_type& natives, datetime_type const& datetime) {
+        boolean_type const special = datetime.is_special();
+        std::vector<size_type> const& formatted = special ? p.all : p.formatted;
+
+        if (!formatted.empty()) {
+            string_type const formatted_string = traits_type::format_datetime(special ? p.all_format : p.format, datetime);
+            std::vector<string_type> const& specifiers = text::split(formatted_string, text::literal("|"), formatted.size());
+            AJG_SYNTH_ASSERT(specifiers.size() == formatted.size());
+
+            for (size_type i = 0; i < formatted.size(); ++i) {
+                natives[formatted[i]] = specifiers[i];
             }
         }
-    };
+
+        natives_mask_type const computed = special ? 0 : p.natives & computed_natives();
+        if (computed == 0) {
+            return;
+        }
+
+        time_type     const local = datetime.local_time();
+        date_type     const date  = local.date();
+        duration_type const time  = local.time_of_day();
+        size_type     const hours = static_cast<size_type>(time.hours());
+
+        if (computed & bit(native_d)) natives[native_d] = padded(date.day(), 2);
+        if (computed & bit(native_j)) natives[native_j] = padded(date.day_of_year(), 3);
+        if (computed & bit(native_m)) natives[native_m] = padded(date.month(), 2);
+        if (computed & bit(native_w)) natives[native_w] = text::stringize(static_cast<size_type>(date.day_of_week().as_number()));
+        if (computed & bit(native_y)) natives[native_y] = padded(date.year() % 100, 2);
+        if (computed & bit(native_Y)) natives[native_Y] = padded(date.year(), 4);
+        if (computed & bit(native_H)) natives[native_H] = padded(hours, 2);
+        if (computed & bit(native_I)) natives[native_I] = padded(hours % 12 == 0 ? 12 : hours % 12, 2);
+        if (computed & bit(native_M)) natives[native_M] = padded(time.minutes(), 2);
+        if (computed & bit(native_S)) natives[native_S] = padded(time.seconds(), 2);
+        if (computed & bit(native_T)) natives[native_T] = padded(hours, 2) + char_type(':')
+                                                        + padded(time.minutes(), 2) + char_type(':')
+                                                        + padded(time.seconds(), 2);
+    }
+
+    inline static string_type padded(size_type const n, size_type const width) {
+        string_type const s = text::stringize(n);
+        return s.size() < width ? string_type(width - s.size(), char_type('0')) + s : s;
+    }
+
+///
+/// cook:
+///     Appends the value of a single Django flag.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline static void cook(string_type& s, char_type const flag, natives_type const& natives, datetime_type const& datetime) {
+        switch (flag) {
+        case char_type('a'): s += meridiem(natives); break;
+        case char_type('A'): s += natives[native_p]; break;
+        case char_type('b'): s += text::lower(natives[native_b]); break;
+        case char_type('B'): break; // NOTE: "Not implemented" per the spec.
+        case char_type('c'): s += iso8601(natives, datetime); break;
+        case char_type('d'): s += natives[native_d]; break;
+        case char_type('D'): s += natives[native_a]; break;
+        case char_type('e'): s += natives[native_z]; break; // XXX: Compare against traits_type::to_string_at(timezone, datetime);
+        case char_type('E'): s += natives[native_B]; break; // TODO: Make locale-aware.
+        case char_type('f'): s += informal(natives); break;
+        case char_type('F'): s += natives[native_B]; break;
+        case char_type('g'): s += text::trim_leading_zeros(natives[native_I]); break;
+        case char_type('G'): s += text::trim_leading_zeros(natives[native_H]); break;
+        case char_type('h'): s += natives[native_I]; break;
+        case char_type('H'): s += natives[native_H]; break;
+        case char_type('i'): s += natives[native_M]; break;
+        case char_type('I'): s += text::literal(traits_type::is_dst(datetime) ? "1" : "0"); break;
+        case char_type('j'): s += text::trim_leading_zeros(natives[native_d]); break;
+        case char_type('l'): s += natives[native_A]; break;
+        case char_type('L'): s += text::literal(is_leapyear(datetime) ? "True" : "False"); break;
+        case char_type('m'): s += natives[native_m]; break;
+        case char_type('M'): s += natives[native_b]; break;
+        case char_type('n'): s += text::trim_leading_zeros(natives[native_m]); break;
+        case char_type('N'): s += natives[native_b]; break; // TODO: Use A.P. style.
+        case char_type('o'): s += natives[native_G]; break;
+        case char_type('O'): s += stringify(offset(datetime), false); break;
+        case char_type('P'): s += informal(natives); break;
+        case char_type('r'): s += rfc2822(natives, datetime); break;
+        case char_type('s'): s += natives[native_S]; break;
+        case char_type('S'): s += ordinal_suffix(static_cast<int>(traits_type::to_date(datetime).day())); break;
+        case char_type('t'): s += text::stringize(static_cast<size_type>(traits_type::to_date(datetime).end_of_month().day())); break;
+        case char_type('T'): s += machine_zone(); break;
+        case char_type('u'): s += text::trim_left(natives[native_f], text::literal(".")); break;
+        case char_type('U'): s += text::stringize(unix_stamp(datetime)); break;
+        case char_type('w'): s += natives[native_w]; break;
+        case char_type('W'): s += text::stringize(static_cast<size_type>(traits_type::to_date(datetime).week_number())); break;
+        case char_type('y'): s += natives[native_y]; break;
+        case char_type('Y'): s += natives[native_Y]; break;
+        case char_type('z'): s += text::trim_leading_zeros(natives[native_j]); break;
+        case char_type('Z'): s += text::stringize(static_cast<integer_type>(offset(datetime).total_seconds())); break;
+        default: AJG_SYNTH_ASSERT(false);
+        }
+    }
+
+    inline static string_type meridiem(natives_type const& natives) {
+        return natives[native_p] == text::literal("AM") ? text::literal("a.m.")
+             : natives[native_p] == text::literal("PM") ? text::literal("p.m.")
+             : string_type();
+    }
+
+    inline static string_type informal(natives_type const& natives) {
+        boolean_type const has_minutes = natives[native_M] != text::literal("00");
+
+        if (natives[native_H] == text::literal("00") && !has_minutes) {
+            return text::literal("midnight");
+        }
+        else if (natives[native_H] == text::literal("12") && !has_minutes) {
+            return text::literal("noon");
+        }
+        return text::trim_leading_zeros(natives[native_I])
+             + (has_minutes ? char_type(':') + natives[native_M] : string_type())
+             + char_type(' ') + meridiem(natives);
+    }
+
+    inline static string_type iso8601(natives_type const& natives, datetime_type const& datetime) {
+        timezone_type const timezone = traits_type::to_timezone(datetime);
+        return natives[native_Y] + char_type('-')
+             + natives[native_m] + char_type('-')
+             + natives[native_d] + char_type('T')
+             + natives[native_H] + char_type(':')
+             + natives[native_M] + char_type(':')
+             + natives[native_S]
+             + (traits_type::to_boolean(timezone) ? stringify(offset(datetime), true) : string_type());
+    }
+
+    inline static string_type rfc2822(natives_type const& natives, datetime_type const& datetime) {
+        return natives[native_a] + text::literal(", ")
+             + natives[native_d] + char_type(' ')
+             + natives[native_b] + char_type(' ')
+             + natives[native_Y] + char_type(' ')
+             + natives[native_T] + char_type(' ')
+             + stringify(offset(datetime), false);
+    }
+
+    inline static boolean_type is_leapyear(datetime_type const& datetime) {
+        size_type const year = static_cast<size_type>(traits_type::to_date(datetime).year());
+        return (year & 3) == 0 && ((year % 25) != 0 || (year & 15) == 0);
+    }
+
+    inline static duration_type offset(datetime_type const& datetime) {
+        return traits_type::to_duration_at(traits_type::to_timezone(datetime), datetime);
+    }
+
+    inline static size_type unix_stamp(datetime_type const& datetime) {
+     // time_type     const utc_epoch   = traits_type::to_time(std::time_t(0));
+        time_type     const utc_epoch   = traits_type::to_time(traits_type::to_date(1970, 1, 1));
+        duration_type const since_epoch = traits_type::to_utc_time(datetime) - utc_epoch;
+        return static_cast<size_type>(since_epoch.seconds());
+    }
+
+    inline static string_type machine_zone() {
+        timezone_type const machine_tz = traits_type::machine_timezone();
+        datetime_type const machine_dt = traits_type::local_datetime(machine_tz);
+        return traits_type::to_string_at(machine_tz, machine_dt);
+    }
+
+    inline static string_type stringify(duration_type const& offset, boolean_type const colon) {
+        return (offset.is_negative() ? char_type('-') : char_type('+'))
+             + (text::digitize(static_cast<size_type>(offset.hours()), 2))
+             + (colon ? text::literal(":") : string_type())
+             + (text::digitize(static_cast<size_type>(offset.minutes()), 2))
+             ;
+    }
+
+    inline static string_type ordinal_suffix(int const n) {
+        AJG_SYNTH_ASSERT(n > 0 && n <= 31);
+        switch (n) {
+        case 1: case 21: return text::literal("st");
+        case 2: case 22: return text::literal("nd");
+        case 3: case 23: return text::literal("rd");
+        default:         return text::literal("th");
+        }
+    }
 
   public:
 
     static string_type format_datetime(string_type const& format, datetime_type const& datetime) {
-        native_flags const native = native_flags::from_datetime(datetime);
-        cooked_flags const cooked = cooked_flags::cook_flags(native, datetime);
+        program const& p = formatter::compiled(format);
+        natives_type natives;
+        formatter::load_natives(p, natives, datetime);
 
-        // TODO: This might not be UTF8-safe; consider using a utf8_iterator.
-        std::basic_ostringstream<char_type> stream;
-        for (auto const& c : format) {
-            switch (c) {
-            case char_type('a'): stream << cooked.a; break;
-            case char_type('A'): stream << cooked.A; break;
-            case char_type('b'): stream << cooked.b; break;
-            case char_type('B'): stream << cooked.B; break;
-            case char_type('c'): stream << cooked.c; break;
-            case char_type('d'): stream << cooked.d; break;
-            case char_type('D'): stream << cooked.D; break;
-            case char_type('e'): stream << cooked.e; break;
-            case char_type('E'): stream << cooked.E; break;
-            case char_type('f'): stream << cooked.f; break;
-            case char_type('F'): stream << cooked.F; break;
-            case char_type('g'): stream << cooked.g; break;
-            case char_type('G'): stream << cooked.G; break;
-            case char_type('h'): stream << cooked.h; break;
-            case char_type('H'): stream << cooked.H; break;
-            case char_type('i'): stream << cooked.i; break;
-            case char_type('I'): stream << cooked.I; break;
-            case char_type('j'): stream << cooked.j; break;
-            case char_type('l'): stream << cooked.l; break;
-            case char_type('L'): stream << cooked.L; break;
-            case char_type('m'): stream << cooked.m; break;
-            case char_type('M'): stream << cooked.M; break;
-            case char_type('n'): stream << cooked.n; break;
-            case char_type('N'): stream << cooked.N; break;
-            case char_type('o'): stream << cooked.o; break;
-            case char_type('O'): stream << cooked.O; break;
-            case char_type('P'): stream << cooked.P; break;
-            case char_type('r'): stream << cooked.r; break;
-            case char_type('s'): stream << cooked.s; break;
-            case char_type('S'): stream << cooked.S; break;
-            case char_type('t'): stream << cooked.t; break;
-            case char_type('T'): stream << cooked.T; break;
-            case char_type('u'): stream << cooked.u; break;
-            case char_type('U'): stream << cooked.U; break;
-            case char_type('w'): stream << cooked.w; break;
-            case char_type('W'): stream << cooked.W; break;
-            case char_type('y'): stream << cooked.y; break;
-            case char_type('Y'): stream << cooked.Y; break;
-            case char_type('z'): stream << cooked.z; break;
-            case char_type('Z'): stream << cooked.Z; break;
-            default: stream << c;
+        string_type result;
+        for (auto const& i : p.instructions) {
+            if (i.flag == 0) {
+                result += i.literal;
+            }
+            else {
+                formatter::cook(result, i.flag, natives, datetime);
             }
         }
+        return result;
+    }
+
+    // Writes straight to the stream: literals as they are, each flag through a reused scratch string.
+    static void format_datetime(ostream_type& ostream, string_type const& format, datetime_type const& datetime) {
+        program const& p = formatter::compiled(format);
+        natives_type natives;
+        formatter::load_natives(p, natives, datetime);
 
-        AJG_SYNTH_ASSERT(stream);
-        return stream.str();
+        string_type scratch;
+        for (auto const& i : p.instructions) {
+            if (i.flag == 0) {
+                ostream.write(i.literal.data(), static_cast<std::streamsize>(i.literal.size()));
+            }
+            else {
+                scratch.clear();
+                formatter::cook(scratch, i.flag, natives, datetime);
+                ostream.write(scratch.data(), static_cast<std::streamsize>(scratch.size()));
+            }
+        }
     }
 
   public:
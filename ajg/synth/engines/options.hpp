@@ -103,7 +103,19 @@ struct options {
 
   public:
 
-    options() : debug(false), caching(caching_none) {}
+    options()
+        : debug(false)
+        , caching(caching_none)
+        , linking(false)
+        , coarse_clock(false)
+        , exec_ttl(0)
+        , exec_timeout(0)
+        , exec_concurrency(0)
+        , exec_ahead(false)
+        , include_concurrency(1)
+        , loop_concurrency(1)
+        , parse_step_limit(0)
+        , parse_time_limit(0) {}
 
   public:
 
@@ -116,6 +128,16 @@ struct options {
     loaders_type      loaders;
     resolvers_type    resolvers;
     caching_type      caching;
+    boolean_type      linking; // Whether to resolve constant paths (e.g. in include/extends) at parse time.
+    boolean_type      coarse_clock; // Whether to reuse formatted current times within the same second.
+    size_type         exec_ttl;         // Seconds to reuse the output of an exec'd command for, if any.
+    size_type         exec_timeout;     // Seconds after which an exec'd command is killed, if any.
+    size_type         exec_concurrency; // Most commands exec'd at once, process-wide (zero is unbounded.)
+    boolean_type      exec_ahead;       // Whether to start a block's independent exec'd commands together, up front.
+    size_type         include_concurrency; // Most linked includes per block rendered at once (zero is unbounded); has no effect without linking.
+    size_type         loop_concurrency;    // Most chunks a long loop is rendered in at once (zero is one per core.)
+    size_type         parse_step_limit; // Most grammar steps parsing may take per character of source (zero is unbounded.)
+    size_type         parse_time_limit; // Milliseconds parsing may take, checked as steps are taken (zero is unbounded.)
 };
 
 
@@ -7,12 +7,16 @@
 
 #include <map>
 #include <string>
+#include <future>
+#include <iterator>
 #include <functional>
 
 #include <boost/bind.hpp>
 
-#include <ajg/synth/detail/pipe.hpp>
 #include <ajg/synth/detail/text.hpp>
+#include <ajg/synth/detail/command.hpp>
+#include <ajg/synth/detail/file_cache.hpp>
+#include <ajg/synth/detail/pipe.hpp>
 
 namespace ajg {
 namespace synth {
@@ -106,13 +110,22 @@ enum { interpolated = true, raw = false };
 #define AJG_SYNTH_SSI_FOREACH_ATTRIBUTE_IN(x, how, if_statement) do { \
     for (auto const& attr : args.kernel.select_nested(x, args.kernel.attribute)) { \
         std::pair<string_type, string_type> const attribute = args.kernel.parse_attribute(attr, args, how); \
-        string_type const name = attribute.first, value = attribute.second; \
+        string_type const& name = attribute.first, & value = attribute.second; (void) value; \
         if_statement else AJG_SYNTH_THROW(invalid_attribute(text::narrow(name))); \
     } \
 } while (0)
 
 #define AJG_SYNTH_SSI_NO_ATTRIBUTES_IN(x) AJG_SYNTH_SSI_FOREACH_ATTRIBUTE_IN(x, raw, if (false) {})
 
+//
+// cached:
+//     Whether (and with whom) file contents and metadata may be shared across renders.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline static detail::file_caching cached(options_type const& options) {
+        return file_caching_for(options.caching);
+    }
+
 //
 // validate_attribute
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -141,13 +154,13 @@ enum { interpolated = true, raw = false };
 
         static void render(args_type const& args) {
             AJG_SYNTH_SSI_FOREACH_ATTRIBUTE_IN(args.match, interpolated,
-                if (name == text::literal("sizefmt")) {
+                if (text::iequals(name, "sizefmt")) {
                     validate_attribute("sizefmt", value, "bytes", "abbrev");
                     args.context.format(text::literal("sizefmt"), value);
                 }
-                else if (name == text::literal("timefmt")) args.context.format(text::literal("timefmt"), value);
-                else if (name == text::literal("echomsg")) args.context.format(text::literal("echomsg"), value);
-                else if (name == text::literal("errmsg"))  args.context.format(text::literal("errmsg"),  value);
+                else if (text::iequals(name, "timefmt")) args.context.format(text::literal("timefmt"), value);
+                else if (text::iequals(name, "echomsg")) args.context.format(text::literal("echomsg"), value);
+                else if (text::iequals(name, "errmsg"))  args.context.format(text::literal("errmsg"),  value);
             );
         }
     };
@@ -165,14 +178,14 @@ enum { interpolated = true, raw = false };
         static void render(args_type const& args) {
             string_type encoding = text::literal("entity");
             AJG_SYNTH_SSI_FOREACH_ATTRIBUTE_IN(args.match, interpolated,
-                if (name == text::literal("var")) {
+                if (text::iequals(name, "var")) {
                     string_type const result = args.kernel.lookup_variable(args.context, args.options, value);
                     if      (encoding == text::literal("none"))   args.ostream << result;
                     else if (encoding == text::literal("url"))    args.ostream << text::uri_encode(result);
                     else if (encoding == text::literal("entity")) args.ostream << text::escape_entities(result);
                     else AJG_SYNTH_THROW(invalid_attribute("encoding"));
                 }
-                else if (name == text::literal("encoding")) {
+                else if (text::iequals(name, "encoding")) {
                     validate_attribute("encoding", value, "none", "url", "entity");
                     encoding = value;
                 }
@@ -185,23 +198,90 @@ enum { interpolated = true, raw = false };
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
     struct exec_tag {
+        typedef std::map<void const*, std::shared_future<std::string> >        launched_type;
+
         static regex_type syntax(kernel_type const& kernel) {
             return kernel.make_tag(text::literal("exec"));
         }
 
         static void render(args_type const& args) {
             AJG_SYNTH_SSI_FOREACH_ATTRIBUTE_IN(args.match, interpolated,
-                if (name == text::literal("cgi")) {
+                if (text::iequals(name, "cgi")) {
                     // TODO:
                     // AJG_SYNTH_ASSERT(detail::file_exists(value));
                     AJG_SYNTH_THROW(not_implemented("exec cgi"));
                 }
-                else if (name == text::literal("cmd")) {
-                    detail::pipe pipe(text::narrow(value));
-                    pipe.read_into(args.ostream);
+                else if (text::iequals(name, "cmd")) {
+                    write_output(args, text::narrow(value));
                 }
             );
         }
+
+        inline static detail::command_limits limits(options_type const& options) {
+            return detail::command_limits(options.exec_ttl, options.exec_timeout, options.exec_concurrency);
+        }
+
+        // The commands started ahead of time for the block being rendered, if any.
+        inline static launched_type*& launched() {
+            static AJG_SYNTH_THREAD_LOCAL launched_type* launched = 0;
+            return launched;
+        }
+
+        inline static void write_output(args_type const& args, std::string const& command) {
+            if (launched_type* const l = launched()) {
+                typename launched_type::iterator const it = l->find(&args.match);
+                if (it != l->end()) {
+                    args.ostream << text::widen(it->second.get());
+                    return;
+                }
+            }
+
+            detail::command_limits const l = limits(args.options);
+            if (l.unlimited()) { // Stream the output straight through, without holding on to it.
+                detail::pipe pipe(command);
+                pipe.read_into(args.ostream);
+            }
+            else {
+                args.ostream << text::widen(detail::execute_command(command, l));
+            }
+        }
+
+//
+// exec_tag::launch:
+//     Starts every exec directly within a block whose command doesn't depend on variables, so
+//     that they run concurrently; their output is still written in order, as each is rendered.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+        inline static void launch( kernel_type   const& kernel
+                                 , match_type    const& block
+                                 , options_type  const& options
+                                 , launched_type&       launched
+                                 ) {
+            for (auto const& nested : block.nested_results()) {
+                if (!kernel.is(nested, kernel.tag)) {
+                    continue;
+                }
+
+                match_type const& match = kernel.unnest(nested);
+                if (kernel.builtin_tags_.get(match.regex_id()) != exec_tag::render) {
+                    continue;
+                }
+
+                auto const attributes = kernel.select_nested(match, kernel.attribute);
+                if (std::distance(attributes.begin(), attributes.end()) != 1) {
+                    continue;
+                }
+
+                match_type  const& attribute = *attributes.begin();
+                string_type const  name      = attribute(kernel.name).str();
+                string_type const  value     = kernel.extract_attribute(attribute(kernel.quoted_value));
+
+                if (text::iequals(name, "cmd") && value.find(char_type('$')) == string_type::npos) {
+                    launched[&match] = std::async(std::launch::async, &detail::execute_command,
+                        text::narrow(value), limits(options)).share();
+                }
+            }
+        }
     };
 
 //
@@ -215,13 +295,14 @@ enum { interpolated = true, raw = false };
 
         static void render(args_type const& args) {
             AJG_SYNTH_SSI_FOREACH_ATTRIBUTE_IN(args.match, interpolated,
-                if (name == text::literal("virtual")) {
+                if (text::iequals(name, "virtual")) {
                     // TODO: Parse REQUEST_URI and figure our path out.
                     AJG_SYNTH_THROW(not_implemented("fsize virtual"));
                 }
-                else if (name == text::literal("file")) {
+                else if (text::iequals(name, "file")) {
                     string_type const format = args.context.format(text::literal("timefmt"));
-                    std::time_t const stamp  = detail::stat_file(text::narrow(value)).st_mtime;
+                    args.context.add_dependency(traits_type::to_path(value));
+                    std::time_t const stamp  = detail::stat_file(text::narrow(value), cached(args.options)).st_mtime;
                     args.ostream << traits_type::format_time(format, traits_type::to_time(stamp));
                 }
             );
@@ -243,12 +324,13 @@ enum { interpolated = true, raw = false };
             validate_attribute("size_format", format, "bytes", "abbrev");
 
             AJG_SYNTH_SSI_FOREACH_ATTRIBUTE_IN(args.match, interpolated,
-                if (name == text::literal("virtual")) {
+                if (text::iequals(name, "virtual")) {
                     // TODO: Parse REQUEST_URI and figure our path out.
                     AJG_SYNTH_THROW(not_implemented("fsize virtual"));
                 }
-                else if (name == text::literal("file")) {
-                    size_type const size = detail::stat_file(text::narrow(value)).st_size;
+                else if (text::iequals(name, "file")) {
+                    args.context.add_dependency(traits_type::to_path(value));
+                    size_type const size = detail::stat_file(text::narrow(value), cached(args.options)).st_size;
                     abbreviate ? args.ostream << traits_type::format_size(size) : args.ostream << size;
                 }
             );
@@ -292,7 +374,7 @@ enum { interpolated = true, raw = false };
 
             if (name == text::literal("if") || name == text::literal("elif")) {
                 AJG_SYNTH_SSI_FOREACH_ATTRIBUTE_IN(tag, raw,
-                    if (name == text::literal("expr")) {
+                    if (text::iequals(name, "expr")) {
                         if (!has_expr) has_expr = true;
                         else AJG_SYNTH_THROW(duplicate_attribute("expr"));
 
@@ -328,11 +410,11 @@ enum { interpolated = true, raw = false };
 
         static void render(args_type const& args) {
             AJG_SYNTH_SSI_FOREACH_ATTRIBUTE_IN(args.match, interpolated,
-                if (name == text::literal("virtual")) {
+                if (text::iequals(name, "virtual")) {
                     // TODO: Parse REQUEST_URI and figure our path out.
                     AJG_SYNTH_THROW(not_implemented("include virtual"));
                 }
-                else if (name == text::literal("file")) {
+                else if (text::iequals(name, "file")) {
                     args.kernel.render_path(args.ostream, traits_type::to_path(value), args.context, args.options);
                 }
             );
@@ -370,11 +452,11 @@ enum { interpolated = true, raw = false };
             boost::optional<value_type>  value_;
 
             AJG_SYNTH_SSI_FOREACH_ATTRIBUTE_IN(args.match, interpolated,
-                if (name == text::literal("var")) {
+                if (text::iequals(name, "var")) {
                     if (name_) AJG_SYNTH_THROW(duplicate_attribute("name"));
                     else name_ = value;
                 }
-                else if (name == text::literal("value")) {
+                else if (text::iequals(name, "value")) {
                     if (value_) AJG_SYNTH_THROW(duplicate_attribute("value"));
                     else value_ = value;
                 }
@@ -14,9 +14,6 @@
 #include <utility>
 #include <algorithm>
 
-#include <boost/ref.hpp>
-#include <boost/bind.hpp>
-#include <boost/function.hpp>
 #include <boost/optional.hpp>
 
 #include <ajg/synth/templates.hpp>
@@ -41,6 +38,8 @@ struct engine : base_engine<Traits> {
     typedef typename traits_type::boolean_type                                  boolean_type;
     typedef typename traits_type::char_type                                     char_type;
     typedef typename traits_type::size_type                                     size_type;
+    typedef typename traits_type::datetime_type                                 datetime_type;
+    typedef typename traits_type::timezone_type                                 timezone_type;
     typedef typename traits_type::path_type                                     path_type;
     typedef typename traits_type::string_type                                   string_type;
     typedef typename traits_type::ostream_type                                  ostream_type;
@@ -58,6 +57,25 @@ struct engine : base_engine<Traits> {
     static boolean_type const throw_on_errors    = false;
     static size_type const    max_regex_captures = 9;
 
+  private:
+
+//
+// captures_type:
+//     What the last regular expression matched while rendering, from which capture variables
+//     ($0 through $9) are looked up on demand, rather than all set (or unset) after every match;
+//     it's shared by the kernels of every template rendered with the same context (e.g. includes.)
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    struct captures_type {
+        typedef boost::xpressive::match_results<typename string_type::const_iterator> match_type;
+
+        captures_type() : evaluated(false) {}
+
+        string_type  subject;
+        match_type   match;
+        boolean_type evaluated;
+    };
+
   public:
 
     template <class Iterator>
@@ -195,7 +213,7 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
         // TODO: value, and possibly name, need to be unencoded
         //       (html entities) before processing, in some cases.
         string_type const temp  = extract_attribute(attr(this->quoted_value));
-        string_type const name  = text::lower(attr(this->name).str());
+        string_type const name  = attr(this->name).str(); // NOTE: Compared using text::iequals.
         string_type const value = interpolate ? this->interpolate(args, temp) : temp;
         return std::make_pair(name, value);
     }
@@ -213,11 +231,15 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
                                ) const {
         string_type const time_format = context.format(text::literal("timefmt"));
 
-        // First, check the context.
-        if (boost::optional<value_type> const value = context.get(name)) {
+        // First, check the captures of the last regular expression matched, if any.
+        if (boost::optional<string_type> const capture = lookup_capture(context, name)) {
+            return *capture;
+        }
+        // Second, check the context.
+        else if (boost::optional<value_type> const value = context.get(name)) {
             return string_type(value->to_string());
         }
-        // Second, check for magic variables.
+        // Third, check for magic variables.
         else if (name == text::literal("DOCUMENT_NAME")) {
             AJG_SYNTH_THROW(not_implemented("DOCUMENT_NAME"));
         }
@@ -225,16 +247,16 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
             AJG_SYNTH_THROW(not_implemented("DOCUMENT_URI"));
         }
         else if (name == text::literal("DATE_LOCAL")) {
-            return traits_type::format_datetime(time_format, traits_type::local_datetime(context.timezone()));
+            return this->format_now(options, time_format, context.timezone(), traits_type::local_datetime(context.timezone(), context.now()));
         }
         else if (name == text::literal("DATE_GMT")) {
             // return traits_type::format_time(time_format, traits_type::utc_time());
-            return traits_type::format_datetime(time_format, traits_type::utc_datetime());
+            return this->format_now(options, time_format, traits_type::utc_timezone(), traits_type::utc_datetime(context.now()));
         }
         else if (name == text::literal("LAST_MODIFIED")) {
             AJG_SYNTH_THROW(not_implemented("LAST_MODIFIED"));
         }
-        // Third, check the environment.
+        // Fourth, check the environment.
         else if (boost::optional<typename environment_type::mapped_type> const variable =
                     detail::find(text::narrow(name), this->environment)) {
             return text::widen(*variable);
@@ -245,6 +267,16 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
         }
     }
 
+    inline static string_type format_now( options_type  const& options
+                                        , string_type   const& format
+                                        , timezone_type const& timezone
+                                        , datetime_type const& datetime
+                                        ) {
+        return options.coarse_clock
+            ? traits_type::format_clock(&traits_type::format_datetime, format, timezone, datetime)
+            : traits_type::format_datetime(format, datetime);
+    }
+
     void render( ostream_type&       ostream
                , options_type const& options
                , state_type   const& state
@@ -257,7 +289,21 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
         context.format(text::literal("sizefmt"),  text::literal("bytes"),                    false);
         context.format(text::literal("timefmt"),  text::literal("%A, %d-%b-%Y %H:%M:%S %Z"), false);
 
-        this->render_block(ostream, state.match(), context, options);
+        if (context.template slot<captures_type>() != 0) { // Included, so the includer's captures are still in effect.
+            this->render_block(ostream, state.match(), context, options);
+            return;
+        }
+
+        captures_type captures;
+        context.template slot<captures_type>(&captures);
+        try {
+            this->render_block(ostream, state.match(), context, options);
+        }
+        catch (...) {
+            context.template slot<captures_type>(0);
+            throw;
+        }
+        context.template slot<captures_type>(0);
     }
 
     void render_path( ostream_type&       ostream
@@ -265,7 +311,10 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
                     , context_type&       context
                     , options_type const& options
                     ) const {
-        parse_template<templates::path_template<engine_type> > (path, options)->render_to_stream(ostream, context);
+        typedef templates::path_template<engine_type> template_type;
+        boost::shared_ptr<template_type const> const t = parse_template<template_type>(path, options);
+        context.add_dependency(t->info().first);
+        t->render_to_stream(ostream, context);
     }
 
     void render_plain( ostream_type&       ostream
@@ -281,9 +330,29 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
                      , context_type&       context
                      , options_type const& options
                      ) const {
-        for (auto const& nested : block.nested_results()) {
-            this->render_match(ostream, nested, context, options);
+        if (!options.exec_ahead) {
+            for (auto const& nested : block.nested_results()) {
+                this->render_match(ostream, nested, context, options);
+            }
+            return;
+        }
+
+        typedef typename builtin_tags_type::exec_tag exec_tag;
+        typename exec_tag::launched_type launched;
+        exec_tag::launch(*this, block, options, launched);
+
+        typename exec_tag::launched_type* const previous = exec_tag::launched();
+        exec_tag::launched() = &launched;
+        try {
+            for (auto const& nested : block.nested_results()) {
+                this->render_match(ostream, nested, context, options);
+            }
+        }
+        catch (...) {
+            exec_tag::launched() = previous;
+            throw;
         }
+        exec_tag::launched() = previous;
     }
 
     void render_tag( ostream_type&       ostream
@@ -340,26 +409,52 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
     }
 
     boolean_type equals_regex(args_type const& args, string_match_type const& str, string_match_type const& regex) const {
-        string_type       const left    = parse_string(args, str);
-        string_type       const right   = regex[s1].str();
-        string_regex_type const pattern = string_regex_type::compile(right);
-        size_type         const n       = max_regex_captures;
+        string_regex_type const& pattern  = compiled_regex(regex[s1].str());
+        captures_type*    const  captures = args.context.template slot<captures_type>();
+        AJG_SYNTH_ASSERT(captures != 0);
+
+        // The subject is kept alongside the results, which refer into it, until the next match.
+        captures->subject   = parse_string(args, str);
+        captures->evaluated = true;
+        return x::regex_search(captures->subject, captures->match, pattern);
+    }
+
+    inline static boost::optional<string_type> lookup_capture(context_type const& context, string_type const& name) {
+        captures_type const* const captures = context.template slot<captures_type>();
 
-        for (std::size_t i = 0; i <= n; ++i) {
-            args.context.unset(text::stringize(i));
+        if (captures == 0 || !captures->evaluated || name.size() != 1
+                || name[0] < char_type('0') || name[0] > char_type('0' + max_regex_captures)) {
+            return boost::none;
         }
 
-        string_match_type match;
-        if (x::regex_search(left, match, pattern)) {
-            std::size_t const limit = (std::min)(match.size(), n);
+        size_type const i = static_cast<size_type>(name[0] - char_type('0'));
+        return i < captures->match.size() ? captures->match[i].str() : context.format(text::literal("echomsg"));
+    }
 
-            for (std::size_t i = 0; i <= limit; ++i) {
-                string_type const key = text::stringize(i);
-                args.context.set(key, match[i].str());
-            }
+///
+/// compiled_regex:
+///     Patterns are static in the template text but expressions are only parsed when rendered, so
+///     compiled patterns are kept in a bounded, per-thread cache keyed by their text instead.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline static string_regex_type const& compiled_regex(string_type const& pattern) {
+        typedef std::map<string_type, string_regex_type> regexes_type;
+        static size_type const max_regexes = 256;
+
+        // FIXME: Destroy at program end to avoid leak.
+        static AJG_SYNTH_THREAD_LOCAL regexes_type* regexes = 0;
+        if (regexes == 0) regexes = new regexes_type;
+
+        typename regexes_type::const_iterator const it = regexes->find(pattern);
+        if (it != regexes->end()) {
+            return it->second;
         }
 
-        return match;
+        string_regex_type const compiled = string_regex_type::compile(pattern);
+        if (regexes->size() >= max_regexes) {
+            regexes->clear();
+        }
+        return (*regexes)[pattern] = compiled;
     }
 
     boolean_type equals(args_type const& args, string_match_type const& expr) const {
@@ -417,17 +512,63 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
 
     }
 
+///
+/// interpolate:
+///     Expands $name, ${name} and \$ in a single pass, equivalent to replacing matches of the
+///     variable regex; most attribute values contain no '$' at all and are returned as they are.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
     string_type interpolate(args_type const& args, string_type const& string) const {
-        boost::function<string_type(string_match_type const&)> const formatter =
-            boost::bind(replace_variable, boost::cref(args), _1);
-        return x::regex_replace(string, variable, formatter);
+        size_type const first = string.find(char_type('$'));
+        if (first == string_type::npos) {
+            return string;
+        }
+
+        size_type const n = string.size();
+        size_type       p = first == 0 ? 0 : first - 1; // Start right before the '$' in case it is escaped.
+        string_type result(string, 0, p);
+        result.reserve(n);
+
+        while (p < n) {
+            char_type const c = string[p];
+
+            if (c == char_type('\\') && p + 1 < n && string[p + 1] == char_type('$')) {
+                result += char_type('$');
+                p += 2;
+            }
+            else if (c == char_type('$') && (p == 0 || string[p - 1] != char_type('\\'))) {
+                size_type const braced = (p + 1 < n && string[p + 1] == char_type('{')) ? 1 : 0;
+                size_type const begin  = p + 1 + braced;
+                size_type       end    = begin;
+
+                while (end < n && is_word(string[end])) {
+                    ++end;
+                }
+
+                if (end == begin || (braced && (end == n || string[end] != char_type('}')))) {
+                    result += c;
+                    p += 1;
+                }
+                else {
+                    result += args.kernel.lookup_variable(args.context, args.options, string.substr(begin, end - begin));
+                    p = end + braced;
+                }
+            }
+            else {
+                result += c;
+                p += 1;
+            }
+        }
+        return result;
     }
 
   private:
 
-    static string_type replace_variable(args_type const& args, string_match_type const& match) {
-        return match.str() == text::literal("\\$") ? text::literal("$") :
-            args.kernel.lookup_variable(args.context, args.options, match[s1].str());
+    inline static boolean_type is_word(char_type const c) {
+        return (c >= char_type('a') && c <= char_type('z'))
+            || (c >= char_type('A') && c <= char_type('Z'))
+            || (c >= char_type('0') && c <= char_type('9'))
+            || c == char_type('_');
     }
 
   public:
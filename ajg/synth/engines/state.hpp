@@ -5,9 +5,15 @@
 #ifndef AJG_SYNTH_ENGINES_BASE_STATE_HPP_INCLUDED
 #define AJG_SYNTH_ENGINES_BASE_STATE_HPP_INCLUDED
 
+#include <map>
+#include <set>
+#include <chrono>
 #include <vector>
+#include <iterator>
 #include <algorithm>
+#include <sys/stat.h>
 
+#include <ajg/synth/footprint.hpp>
 #include <ajg/synth/detail/text.hpp>
 
 #include <ajg/synth/engines/context.hpp>
@@ -30,6 +36,7 @@ struct state : boost::noncopyable {
     typedef state                                                               state_type;
 
     typedef typename options_type::value_type                                   value_type;
+    typedef typename options_type::context_type                                 context_type;
     typedef typename options_type::filter_type                                  filter_type;
     typedef typename options_type::filters_type                                 filters_type;
     typedef typename options_type::tag_type                                     tag_type;
@@ -59,14 +66,25 @@ struct state : boost::noncopyable {
     typedef typename traits_type::datetime_type                                 datetime_type;
     typedef typename traits_type::duration_type                                 duration_type;
     typedef typename traits_type::string_type                                   string_type;
+    typedef typename traits_type::path_type                                     path_type;
     typedef typename traits_type::paths_type                                    paths_type;
     typedef typename traits_type::names_type                                    names_type;
+    typedef typename traits_type::formats_type                                  formats_type;
     typedef typename traits_type::istream_type                                  istream_type;
     typedef typename traits_type::ostream_type                                  ostream_type;
 
+    typedef typename context_type::block_type                                   block_type;
+    typedef typename context_type::overrides_type                               overrides_type;
+    typedef typename context_type::inheritance_type                             inheritance_type;
     typedef typename range_type::first_type                                     iterator_type;
 
     typedef std::vector<string_type>                                            pieces_type;
+    typedef std::map<match_type const*, block_type>                             links_type;
+    typedef std::set<match_type const*>                                         marks_type;
+    typedef std::map<path_type, struct stat>                                    dependencies_type;
+    typedef synth::footprint                                                    footprint_type;
+    typedef std::chrono::steady_clock                                           clock_type;
+    typedef boost::optional<clock_type::time_point>                             deadline_type;
 
   private:
 
@@ -79,6 +97,8 @@ struct state : boost::noncopyable {
         , range_(range)
         , options_(options)
         , iterator_(range_.first)
+        , steps_(0)
+        , max_steps_(0)
         , loaders_(options.loaders)
         , loaded_libraries_(options.libraries) {}
 
@@ -100,6 +120,40 @@ struct state : boost::noncopyable {
 
     inline boolean_type consumed() const { return this->furthest() == this->end();}
 
+//
+// start_budget, take_step:
+//     Keep parsing within the limits given by the options, if any, by having the grammar take
+//     a step every time it (re)tries a tag or an expression, and one per character of plain text it
+//     (re)scans; the latter returns why parsing should stop, if it should. Since time is only checked
+//     every so often, it may be overrun a bit.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void start_budget() {
+        this->steps_ = 0;
+
+        if (size_type const limit = this->options_.parse_step_limit) {
+            this->max_steps_ = limit * (std::distance(this->begin(), this->end()) + 1);
+        }
+        if (size_type const limit = this->options_.parse_time_limit) {
+            this->deadline_ = clock_type::now() + std::chrono::milliseconds(limit);
+        }
+    }
+
+    inline char const* take_step(size_type const steps = 1) {
+        size_type const previous = this->steps_;
+        this->steps_ += steps;
+
+        if (this->max_steps_ != 0 && this->steps_ > this->max_steps_) {
+            return "parse step limit exceeded";
+        }
+        if (this->deadline_ && previous / 256 != this->steps_ / 256 && clock_type::now() > *this->deadline_) {
+            return "parse time limit exceeded";
+        }
+        return 0;
+    }
+
+    inline size_type steps() const { return this->steps_; }
+
     inline string_type line(size_type const limit) const {
         iterator_type const it = this->furthest();
         size_type     const buffer(std::distance(it, this->end()));
@@ -139,6 +193,64 @@ struct state : boost::noncopyable {
         this->parsed_renderers_[position] = renderer;
     }
 
+    inline block_type const* get_link(match_type const& match) const {
+        typename links_type::const_iterator const it = this->links_.find(&match);
+        return it == this->links_.end() ? 0 : &it->second;
+    }
+
+    inline void set_link(match_type const& match, block_type const& link) {
+        this->links_[&match] = link;
+    }
+
+    // Whether the match was found, at parse time, to be renderable apart from what surrounds it.
+    inline boolean_type is_isolated(match_type const& match) const {
+        return this->isolated_.find(&match) != this->isolated_.end();
+    }
+
+    inline void set_isolated(match_type const& match) {
+        this->isolated_.insert(&match);
+    }
+
+    inline dependencies_type const& dependencies() const { return this->dependencies_; }
+
+    inline void add_dependency(path_type const& path, struct stat const& stats) {
+        this->dependencies_[path] = stats;
+    }
+
+    inline inheritance_type&       inheritance()       { return this->inheritance_; }
+    inline inheritance_type const& inheritance() const { return this->inheritance_; }
+
+    // Leaves the source's size to the template, which knows whether the source is owned.
+    footprint_type footprint() const {
+        typedef footprint_type f;
+        auto const string_key = [](typename libraries_type::value_type const& e) { return f::string(e.first); };
+        footprint_type result;
+
+        result.matches   = f::match(this->match_) - sizeof(match_type);
+        result.renderers = f::map(this->parsed_renderers_) + f::strings(this->library_tag_args_);
+        result.libraries = f::map(this->loaded_libraries_, string_key)
+                         + f::map(this->loaded_tags_,      [](typename tags_type::value_type const& e)    { return f::string(e.first); })
+                         + f::map(this->loaded_filters_,   [](typename filters_type::value_type const& e) { return f::string(e.first); })
+                         + this->loaders_.capacity() * sizeof(loader_type);
+        result.options   = sizeof(options_type)
+                         + f::strings(this->options_.directories)
+                         + f::map(this->options_.libraries, string_key)
+                         + this->options_.loaders.capacity()   * sizeof(loader_type)
+                         + this->options_.resolvers.capacity() * sizeof(resolver_type)
+                         + f::string(this->options_.metadata.application)
+                         + f::map(this->options_.metadata.formats, [](typename formats_type::value_type const& e) {
+                               return f::string(e.first) + f::string(e.second);
+                           });
+        result.other     = sizeof(state) - sizeof(options_type)
+                         + f::map(this->links_)
+                         + f::map(this->isolated_)
+                         + f::map(this->dependencies_, [](typename dependencies_type::value_type const& e) { return f::string(e.first); })
+                         + f::map(this->inheritance_.overrides, [](typename overrides_type::value_type const& e) {
+                               return f::string(e.first) + e.second.capacity() * sizeof(block_type);
+                           });
+        return result;
+    }
+
     inline pieces_type get_pieces(string_type const& name, string_type const& c) {
         // TODO: These numbers assume that block_open and block_close will always be 2
         //       characters wide, which may not be the case if they become configurable.
@@ -217,6 +329,13 @@ struct state : boost::noncopyable {
     range_type               range_;
     options_type             options_;
     iterator_type            iterator_;
+    links_type               links_;
+    marks_type               isolated_;
+    dependencies_type        dependencies_;
+    inheritance_type         inheritance_;
+    size_type                steps_;
+    size_type                max_steps_;
+    deadline_type            deadline_;
 
   public: // TODO: private:
 
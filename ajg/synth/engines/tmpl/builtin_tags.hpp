@@ -7,6 +7,10 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
 
 #include <ajg/synth/detail/find.hpp>
 #include <ajg/synth/detail/text.hpp>
@@ -169,10 +173,117 @@ struct builtin_tags {
     };
 
 //
-// loop_tag
+// loop_tag:
+//     Rather than copying each item and the loop variables into the context on every iteration,
+//     publishes a frame through which they're resolved, and only when actually referenced.
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
     struct loop_tag {
+        struct frame : boost::noncopyable {
+          public:
+
+            typedef std::vector<std::pair<string_type, value_type> >           bindings_type;
+
+          public:
+
+            frame(boolean_type const caseless, size_type const size, frame const* const parent)
+                : parent(parent), caseless(caseless), size(size), index(0), item_(0), bound_(false) {}
+
+            inline void advance(value_type const& item) {
+                this->item_  = &item;
+                this->bound_ = false;
+                this->bindings_.clear();
+                ++this->index;
+            }
+
+            // Item variables take precedence, as they did when both were copied into the context.
+            inline optional<value_type> get(string_type const& key) const {
+                if (!this->bound_) {
+                    this->bind();
+                }
+
+                for (auto it = this->bindings_.rbegin(); it != this->bindings_.rend(); ++it) {
+                    if (it->first == key) {
+                        return it->second;
+                    }
+                }
+
+                return kernel_type::loop_variables ? this->variable(key) : boost::none;
+            }
+
+          private:
+
+            inline void bind() const {
+                for (auto const& pair : *this->item_) {
+                    string_type const k = pair[0].to_string();
+                    this->bindings_.push_back(std::make_pair(this->caseless ? text::lower(k) : k, pair[1]));
+                }
+                this->bound_ = true;
+            }
+
+            inline optional<value_type> variable(string_type const& key) const {
+                if (key.size() < 5 || key[0] != char_type('_') || key[1] != char_type('_')) {
+                    return boost::none;
+                }
+
+                size_type const i = this->index, n = this->size;
+                string_type const* const names = frame::names(this->caseless);
+
+                     if (key == names[size_name])    return value_type(n);
+                else if (key == names[total_name])   return value_type(n);
+                else if (key == names[first_name])   return value_type(to_int(i == 1));
+                else if (key == names[last_name])    return value_type(to_int(i == n));
+                else if (key == names[inner_name])   return value_type(to_int(i != 1 && i != n));
+                else if (key == names[outer_name])   return value_type(to_int(i == 1 || i == n));
+                else if (key == names[odd_name])     return value_type(to_int(i % 2 == 1));
+                else if (key == names[even_name])    return value_type(to_int(i % 2 == 0));
+                else if (key == names[counter_name]) return value_type(i);
+                else                                 return boost::none;
+            }
+
+            // The loop variables' names, as written or lowercased (when caseless), made only once.
+            enum { size_name, total_name, first_name, last_name, inner_name, outer_name, odd_name, even_name, counter_name };
+
+            inline static string_type const* names(boolean_type const caseless) {
+                static string_type const written[] =
+                    { text::literal("__SIZE__")
+                    , text::literal("__TOTAL__")
+                    , text::literal("__FIRST__")
+                    , text::literal("__LAST__")
+                    , text::literal("__INNER__")
+                    , text::literal("__OUTER__")
+                    , text::literal("__ODD__")
+                    , text::literal("__EVEN__")
+                    , text::literal("__COUNTER__")
+                    };
+                static string_type const lowered[] =
+                    { text::lower(written[size_name])
+                    , text::lower(written[total_name])
+                    , text::lower(written[first_name])
+                    , text::lower(written[last_name])
+                    , text::lower(written[inner_name])
+                    , text::lower(written[outer_name])
+                    , text::lower(written[odd_name])
+                    , text::lower(written[even_name])
+                    , text::lower(written[counter_name])
+                    };
+                return caseless ? lowered : written;
+            }
+
+          public:
+
+            frame const* const parent;
+            boolean_type const caseless;
+            size_type    const size;
+            size_type          index;
+
+          private:
+
+            value_type const*     item_;
+            mutable boolean_type  bound_;
+            mutable bindings_type bindings_;
+        };
+
         static regex_type syntax(kernel_type const& kernel) {
             return OPEN_TAG("LOOP") >> kernel.block >> CLOSE_TAG("LOOP");
         }
@@ -186,31 +297,43 @@ struct builtin_tags {
             match_type const& attr     = match(kernel.name_attribute);
             match_type const& body     = match(kernel.block);
             value_type const  value    = kernel.evaluate(attr, context, options);
-            size_type  const  size     = value.size();
-            size_type         index    = 1;
-
-            stage<context_type> stage(context, kernel_type::global_variables);
-            for (auto const& item : value) {
-                if (kernel_type::loop_variables) {
-                    stage.set(text::literal("__SIZE__"),    size);
-                    stage.set(text::literal("__TOTAL__"),   size);
-                    stage.set(text::literal("__FIRST__"),   to_int(index == 1));
-                    stage.set(text::literal("__LAST__"),    to_int(index == size));
-                    stage.set(text::literal("__INNER__"),   to_int(index != 1 && index != size));
-                    stage.set(text::literal("__OUTER__"),   to_int(index == 1 || index == size));
-                    stage.set(text::literal("__ODD__"),     to_int(index % 2 == 1));
-                    stage.set(text::literal("__EVEN__"),    to_int(index % 2 == 0));
-                    stage.set(text::literal("__COUNTER__"), index++);
+            frame const*      parent   = context.template slot<frame const>();
+            frame             current(context.caseless(), value.size(), parent);
+
+            context.template slot<frame const>(&current);
+            try {
+                for (auto const& item : value) {
+                    current.advance(item);
+                    kernel.render_block(ostream, body, context, options);
                 }
+            }
+            catch (...) {
+                context.template slot<frame const>(parent);
+                throw;
+            }
+            context.template slot<frame const>(parent);
+        }
 
-                for (auto const& pair : item) {
-                    string_type const k = pair[0].to_string();
-                    value_type  const v = pair[1];
-                    stage.set(k, v);
-                }
+//
+// loop_tag::lookup:
+//     Resolves a variable, looking only within the innermost loop, if any, unless the kernel
+//     exposes global (and outer loops') variables inside loops.
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-                kernel.render_block(ostream, body, context, options);
+        inline static optional<value_type> lookup(context_type const& context, string_type const& name) {
+            frame const* const current = context.template slot<frame const>();
+            if (current == 0) {
+                return context.get(name);
             }
+
+            string_type const key = current->caseless ? text::lower(name) : name;
+            for (frame const* f = current; f != 0; f = kernel_type::global_variables ? f->parent : 0) {
+                if (optional<value_type> const& variable = f->get(key)) {
+                    return variable;
+                }
+            }
+
+            return kernel_type::global_variables ? context.get(name) : boost::none;
         }
 
       private:
@@ -261,7 +384,7 @@ struct builtin_tags {
             value_type result;
             typename engine_type::attributes const attrs = kernel.parse_attributes(match);
 
-            if (optional<value_type> const& variable = context.get(attrs.name)) {
+            if (optional<value_type> const& variable = loop_tag::lookup(context, attrs.name)) {
                 result = *variable;
             }
             else if (attrs.fallback) {
@@ -274,8 +397,8 @@ struct builtin_tags {
             if (attrs.escape) {
                 switch (*attrs.escape) {
                 case engine_type::attributes::none: break; // Do nothing.
-                case engine_type::attributes::html: result = text::escape_entities(result.to_string()); break;
-                case engine_type::attributes::url:  result = text::uri_encode(result.to_string());      break;
+                case engine_type::attributes::html: return result.escape(ostream);
+                case engine_type::attributes::url:  return text::uri_encode_into(ostream, result.to_string());
                 case engine_type::attributes::js:   AJG_SYNTH_THROW(not_implemented("js escape mode"));
 
                 }
@@ -204,7 +204,7 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
                                  ) const {
         string_type const name = extract_attribute(attr);
 
-        if (optional<value_type> const& variable = context.get(name)) {
+        if (optional<value_type> const& variable = builtin_tags_type::loop_tag::lookup(context, name)) {
             return *variable;
         }
         else {
@@ -234,7 +234,10 @@ struct engine<Traits>::kernel : base_engine<Traits>::AJG_SYNTH_TEMPLATE base_ker
                     , context_type&       context
                     , options_type const& options
                     ) const {
-        parse_template<templates::path_template<engine_type> > (path, options)->render_to_stream(ostream, context);
+        typedef templates::path_template<engine_type> template_type;
+        boost::shared_ptr<template_type const> const t = parse_template<template_type>(path, options);
+        context.add_dependency(t->info().first);
+        t->render_to_stream(ostream, context);
     }
 
     void render_plain( ostream_type&       ostream
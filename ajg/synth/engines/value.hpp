@@ -430,7 +430,10 @@ struct value {
     template <class V> friend
     typename boost::enable_if<boost::is_same<value_type, V>, ostream_type&>::type
     operator <<(ostream_type& ostream, V const& value) {
-        ostream.imbue(traits_type::standard_locale());
+        // Comparing locales is cheap when they share an implementation; imbuing one never is.
+        if (ostream.getloc() != traits_type::standard_locale()) {
+            ostream.imbue(traits_type::standard_locale());
+        }
 
         // TODO: Move non-output behavior to traits.
         if (value.is_unit()) {
@@ -474,12 +477,24 @@ struct value {
     // NOTE: This method does not copy the actual held value (in the adapter) just the metadata.
     inline value_type metacopy() const { return *this; }
 
-    // TODO: escape(ostream_type& ostream) to reduce string/stream allocations.
     value_type escape() const {
         // XXX: Should this method escape binary and control characters?
         return text::escape_entities(this->to_string());
     }
 
+    // NOTE: Equivalent to `ostream << value.escape()` minus the intermediate string and value.
+    void escape(ostream_type& ostream) const {
+        if (this->template is<string_type>()) {
+            text::escape_entities_into(ostream, this->template as<string_type>());
+        }
+        else if (!this->is_textual() && (this->is_unit() || this->is_boolean() || this->is_numeric())) {
+            ostream << *this; // Nothing to escape.
+        }
+        else {
+            text::escape_entities_into(ostream, this->to_string());
+        }
+    }
+
     value_type get_trail_or(sequence_type const& trail, value_type const& fallback) const {
         value_type value = *this;
 
@@ -83,6 +83,7 @@ struct conversion_error : public exception, public std::runtime_error {
 
 struct parsing_error : public exception, public std::runtime_error {
     parsing_error(std::string const& line) : std::runtime_error("parsing error near `" + line + "`") {}
+    parsing_error(std::string const& line, std::string const& reason) : std::runtime_error("parsing error near `" + line + "` (" + reason + ")") {}
     ~parsing_error() throw () {}
 };
 
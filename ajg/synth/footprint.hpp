@@ -0,0 +1,108 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_FOOTPRINT_HPP_INCLUDED
+#define AJG_SYNTH_FOOTPRINT_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <string>
+#include <cstddef>
+
+namespace ajg {
+namespace synth {
+
+//
+// footprint:
+//     Approximately how many bytes a parsed template retains, broken down by what retains them.
+//     Estimates only count what's reachable from the template itself: containers' elements and
+//     bookkeeping (assuming typical node-based implementations) and strings' heap storage, but
+//     not what's behind opaque objects such as functions or libraries, which may be shared anyway.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct footprint {
+  public:
+
+    typedef std::size_t                                                         size_type;
+
+  public:
+
+    size_type source;    // The text parsed, whether owned (e.g. strings, files) or not (buffers.)
+    size_type matches;   // The parse tree, i.e. the match_results nested within the template's.
+    size_type renderers; // Renderers parsed ahead of time (e.g. for tags from libraries.)
+    size_type libraries; // Libraries loaded, along with the tags and filters taken from them.
+    size_type options;   // The template's own copy of the options it was parsed with.
+    size_type other;     // Everything else, e.g. links, dependencies and inheritance.
+
+  public:
+
+    footprint() : source(0), matches(0), renderers(0), libraries(0), options(0), other(0) {}
+
+  public:
+
+    inline size_type total() const {
+        return this->source + this->matches + this->renderers + this->libraries + this->options + this->other;
+    }
+
+    inline footprint& operator +=(footprint const& that) {
+        this->source    += that.source;
+        this->matches   += that.matches;
+        this->renderers += that.renderers;
+        this->libraries += that.libraries;
+        this->options   += that.options;
+        this->other     += that.other;
+        return *this;
+    }
+
+//
+// footprint::node, footprint::string, footprint::strings, footprint::map, footprint::match:
+//     Estimates of the bytes used by a container's node (beyond its element), by a string's heap
+//     storage, by sequences of strings, by maps and sets (including their nodes' elements, plus
+//     whatever extra estimates for each) and by match results (including their nested results.)
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline static size_type node() { return 4 * sizeof(void*); }
+
+    template <class Char, class Traits, class Allocator>
+    inline static size_type string(std::basic_string<Char, Traits, Allocator> const& s) {
+        size_type const capacity = (s.capacity() + 1) * sizeof(Char);
+        return capacity > sizeof(s) ? capacity : 0; // Short strings tend to be stored in place.
+    }
+
+    template <class Strings>
+    inline static size_type strings(Strings const& strings) {
+        size_type size = strings.capacity() * sizeof(typename Strings::value_type);
+        for (auto const& s : strings) {
+            size += string(s);
+        }
+        return size;
+    }
+
+    template <class Map, class Extra>
+    inline static size_type map(Map const& map, Extra const& extra) {
+        size_type size = map.size() * (node() + sizeof(typename Map::value_type));
+        for (auto const& entry : map) {
+            size += extra(entry);
+        }
+        return size;
+    }
+
+    template <class Map>
+    inline static size_type map(Map const& map) {
+        return map.size() * (node() + sizeof(typename Map::value_type));
+    }
+
+    template <class Match>
+    inline static size_type match(Match const& results) {
+        size_type size = sizeof(Match) + results.size() * sizeof(typename Match::value_type);
+        for (auto const& nested : results.nested_results()) {
+            size += 2 * sizeof(void*) + match(nested); // The (linked list) node holding it.
+        }
+        return size;
+    }
+};
+
+}} // namespace ajg::synth
+
+#endif // AJG_SYNTH_FOOTPRINT_HPP_INCLUDED
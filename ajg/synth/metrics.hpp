@@ -0,0 +1,422 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#ifndef AJG_SYNTH_METRICS_HPP_INCLUDED
+#define AJG_SYNTH_METRICS_HPP_INCLUDED
+
+#include <ajg/synth/support.hpp>
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <typeinfo>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include <boost/noncopyable.hpp>
+
+#include <ajg/synth/detail/unmangle.hpp>
+
+namespace ajg {
+namespace synth {
+
+//
+// metrics:
+//     A process-wide registry of counters, gauges and latency histograms about caching, parsing
+//     and rendering. Each series (a name along with its labels) is resolved once, into a handle,
+//     and each thread updates a shard of its own, indexed by handle, under a lock that's only
+//     contended while the shards are merged, to be exported as Prometheus text or as JSON. What
+//     a thread counted is folded into a shared shard when it exits, so that its own is reclaimed.
+//     NOTE: Gauges are kept as sums of adjustments, so that every shard can contribute to them.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct metrics : boost::noncopyable {
+  public:
+
+    typedef std::vector<std::pair<std::string, std::string> >                   labels_type;
+    typedef std::chrono::steady_clock                                           clock_type;
+
+  private:
+
+    enum kind_type { counter_kind, gauge_kind, histogram_kind };
+
+  public:
+
+    // A handle on a series, e.g. to be kept alongside whatever the series is about.
+    struct series {
+        std::size_t id;
+        kind_type   kind;
+    };
+
+  private:
+
+    struct series_type {
+        kind_type                kind;
+        double                   sum;     // The value itself, unless it's a histogram.
+        std::size_t              count;   // Updates, though only histograms report them.
+        std::vector<std::size_t> buckets; // Observations that fell into each bucket alone.
+
+        series_type() : kind(counter_kind), sum(0), count(0) {}
+    };
+
+    typedef std::pair<std::string, labels_type>                                 key_type;
+    typedef std::map<key_type, series_type>                                     series_map_type;
+
+    struct registry_type {
+        std::map<key_type, std::size_t>    ids;
+        std::vector<key_type>              keys;
+        std::vector<kind_type>             kinds;
+        std::map<std::string, std::size_t> names; // How many series share each name.
+    };
+
+    struct shard_type : boost::noncopyable {
+        std::mutex               mutex;
+        std::vector<series_type> series; // Indexed by id.
+    };
+
+    typedef std::vector<shard_type*>                                            shards_type;
+
+  public:
+
+    inline static series counter  (std::string const& name, labels_type const& labels) { return resolve(counter_kind,   name, labels); }
+    inline static series gauge    (std::string const& name, labels_type const& labels) { return resolve(gauge_kind,     name, labels); }
+    inline static series histogram(std::string const& name, labels_type const& labels) { return resolve(histogram_kind, name, labels); }
+
+    // Series are never released, so those whose labels are open-ended (e.g. a template's name)
+    // are bounded: past `limit` series by the same name, new labels share the `overflow` series.
+    inline static series histogram(std::string const& name, labels_type const& labels, labels_type const& overflow, std::size_t const limit) {
+        return resolve(histogram_kind, name, labels, &overflow, limit);
+    }
+
+    inline static void count        (series const& s, double const n = 1)       { update(s, n); }
+    inline static void adjust       (series const& s, double const delta)       { update(s, delta); }
+    inline static void observe      (series const& s, double const seconds)     { update(s, seconds); }
+    inline static void observe_since(series const& s, clock_type::time_point const start) {
+        observe(s, std::chrono::duration<double>(clock_type::now() - start).count());
+    }
+
+    // These resolve the series every time, so they're best kept to those that are rare or whose
+    // labels vary; the rest are cheaper to resolve once, ahead of time.
+
+    inline static void count(std::string const& name, labels_type const& labels, double const n = 1) {
+        count(counter(name, labels), n);
+    }
+
+    inline static void adjust(std::string const& name, labels_type const& labels, double const delta) {
+        adjust(gauge(name, labels), delta);
+    }
+
+    inline static void observe(std::string const& name, labels_type const& labels, double const seconds) {
+        observe(histogram(name, labels), seconds);
+    }
+
+    inline static void observe_since(std::string const& name, labels_type const& labels, clock_type::time_point const start) {
+        observe_since(histogram(name, labels), start);
+    }
+
+    inline static void count_exception(std::exception const& e) {
+        count("synth_exceptions_total", labels_type(1, std::make_pair("kind", exception_name(e))));
+    }
+
+    // The upper bounds of histogram buckets, in seconds.
+    inline static std::vector<double> const& bounds() {
+        static std::vector<double> const bounds =
+            { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+        return bounds;
+    }
+
+//
+// metrics::dump, metrics::prometheus, metrics::json
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline static std::string dump(std::string const& format) {
+             if (format == "prometheus") return prometheus();
+        else if (format == "json")       return json();
+        else AJG_SYNTH_THROW(std::invalid_argument("metrics format: " + format));
+    }
+
+    static std::string prometheus() {
+        series_map_type const series = merged();
+        std::string text, last;
+
+        for (auto const& entry : series) {
+            std::string const& name = entry.first.first;
+            labels_type const& labels = entry.first.second;
+            series_type const& s = entry.second;
+
+            if (name != last) {
+                static char const* const kinds[] = { "counter", "gauge", "histogram" };
+                text += "# TYPE " + name + ' ' + kinds[s.kind] + '\n';
+                last = name;
+            }
+
+            if (s.kind != histogram_kind) {
+                text += name + prometheus_labels(labels) + ' ' + format_number(s.sum) + '\n';
+                continue;
+            }
+
+            std::size_t cumulative = 0;
+            for (std::size_t i = 0; i < s.buckets.size(); ++i) {
+                labels_type bucket = labels;
+                bucket.push_back(std::make_pair("le", i < bounds().size() ? format_number(bounds()[i]) : "+Inf"));
+                cumulative += s.buckets[i];
+                text += name + "_bucket" + prometheus_labels(bucket) + ' ' + format_number(double(cumulative)) + '\n';
+            }
+            text += name + "_sum"   + prometheus_labels(labels) + ' ' + format_number(s.sum) + '\n';
+            text += name + "_count" + prometheus_labels(labels) + ' ' + format_number(double(s.count)) + '\n';
+        }
+        return text;
+    }
+
+    static std::string json() {
+        series_map_type const series = merged();
+        std::string text = "{", last;
+
+        for (auto const& entry : series) {
+            std::string const& name = entry.first.first;
+            labels_type const& labels = entry.first.second;
+            series_type const& s = entry.second;
+
+            if (name != last) {
+                static char const* const kinds[] = { "counter", "gauge", "histogram" };
+                text += last.empty() ? "" : "]},";
+                text += json_string(name) + ":{\"type\":\"" + kinds[s.kind] + "\",\"series\":[";
+                last = name;
+            }
+            else {
+                text += ',';
+            }
+
+            text += "{\"labels\":{";
+            for (std::size_t i = 0; i < labels.size(); ++i) {
+                text += (i ? "," : "") + json_string(labels[i].first) + ':' + json_string(labels[i].second);
+            }
+            text += '}';
+
+            if (s.kind != histogram_kind) {
+                text += ",\"value\":" + format_number(s.sum) + '}';
+                continue;
+            }
+
+            text += ",\"count\":" + format_number(double(s.count)) + ",\"sum\":" + format_number(s.sum) + ",\"buckets\":{";
+            std::size_t cumulative = 0;
+            for (std::size_t i = 0; i < s.buckets.size(); ++i) {
+                cumulative += s.buckets[i];
+                text += (i ? ",\"" : "\"") + (i < bounds().size() ? format_number(bounds()[i]) : "+Inf") + "\":";
+                text += format_number(double(cumulative));
+            }
+            text += "}}";
+        }
+
+        text += last.empty() ? "}" : "]}}";
+        return text;
+    }
+
+  private:
+
+    inline static series resolve( kind_type          const  kind
+                                , std::string        const& name
+                                , labels_type        const& labels
+                                , labels_type const* const  overflow = 0
+                                , std::size_t        const  limit    = 0
+                                ) {
+        std::lock_guard<std::mutex> const lock(mutex());
+        registry_type& r = registry();
+        key_type key(name, labels);
+
+        std::map<key_type, std::size_t>::const_iterator it = r.ids.find(key);
+        if (it == r.ids.end() && overflow && r.names[name] >= limit) {
+            key.second = *overflow;
+            it = r.ids.find(key);
+        }
+        if (it != r.ids.end()) {
+            series const s = { it->second, r.kinds[it->second] };
+            return s;
+        }
+
+        series const s = { r.keys.size(), kind };
+        r.ids[key] = s.id;
+        r.keys.push_back(key);
+        r.kinds.push_back(kind);
+        ++r.names[name];
+        return s;
+    }
+
+    // The exception's own type, rather than that of whatever it was wrapped in when thrown (e.g.
+    // boost::wrapexcept<T>, which varies with the version of Boost.)
+    inline static std::string exception_name(std::exception const& e) {
+        static char const* const wrappers[] =
+            { "boost::wrapexcept<"
+            , "boost::exception_detail::clone_impl<"
+            , "boost::exception_detail::error_info_injector<"
+            };
+        std::string name = detail::unmangle(typeid(e).name());
+
+        for (bool unwrapped = true; unwrapped;) {
+            unwrapped = false;
+            for (char const* const wrapper : wrappers) {
+                std::size_t const n = std::strlen(wrapper);
+                if (name.size() > n && name.compare(0, n, wrapper) == 0 && name[name.size() - 1] == '>') {
+                    std::size_t const end = name.find_last_not_of(' ', name.size() - 2);
+                    name = name.substr(n, end + 1 - n);
+                    unwrapped = true;
+                }
+            }
+        }
+        return name;
+    }
+
+    inline static void update(series const& handle, double const value) {
+        shard_type& shard = local();
+        std::lock_guard<std::mutex> const lock(shard.mutex);
+        if (handle.id >= shard.series.size()) {
+            shard.series.resize(handle.id + 1);
+        }
+
+        series_type& s = shard.series[handle.id];
+        s.kind = handle.kind;
+        s.sum += value;
+        ++s.count;
+
+        if (handle.kind == histogram_kind) {
+            std::vector<double> const& b = bounds();
+            if (s.buckets.empty()) {
+                s.buckets.resize(b.size() + 1);
+            }
+            ++s.buckets[std::lower_bound(b.begin(), b.end(), value) - b.begin()];
+        }
+    }
+
+    inline static void add(series_type& s, series_type const& other) {
+        s.kind   = other.kind;
+        s.sum   += other.sum;
+        s.count += other.count;
+        s.buckets.resize((std::max)(s.buckets.size(), other.buckets.size()));
+
+        for (std::size_t i = 0; i < other.buckets.size(); ++i) {
+            s.buckets[i] += other.buckets[i];
+        }
+    }
+
+    inline static series_map_type merged() {
+        series_map_type series;
+        std::lock_guard<std::mutex> const lock(mutex());
+        registry_type const& r = registry();
+
+        for (shard_type* const shard : shards()) {
+            std::lock_guard<std::mutex> const shard_lock(shard->mutex);
+
+            for (std::size_t id = 0; id < shard->series.size(); ++id) {
+                if (shard->series[id].count != 0) { // Skipping those resolved but never updated.
+                    add(series[r.keys[id]], shard->series[id]);
+                }
+            }
+        }
+        return series;
+    }
+
+    // Owns a thread's shard, which it folds into the retired one (i.e. the first) on exit.
+    struct owner_type : boost::noncopyable {
+        shard_type* const shard;
+
+        owner_type() : shard(new shard_type) {
+            std::lock_guard<std::mutex> const lock(mutex());
+            shards().push_back(this->shard);
+        }
+
+        ~owner_type() {
+            std::lock_guard<std::mutex> const lock(mutex());
+            shard_type& retired = *shards().front();
+            std::lock_guard<std::mutex> const retired_lock(retired.mutex);
+            retired.series.resize((std::max)(retired.series.size(), this->shard->series.size()));
+
+            for (std::size_t id = 0; id < this->shard->series.size(); ++id) {
+                add(retired.series[id], this->shard->series[id]);
+            }
+            shards().erase(std::find(shards().begin(), shards().end(), this->shard));
+            delete this->shard;
+        }
+    };
+
+    inline static shard_type& local() {
+    #if AJG_SYNTH_HAS_CXX11_THREAD_LOCAL
+        static thread_local owner_type const owner;
+        return *owner.shard;
+    #else
+        // NOTE: Without thread_local, shards outlive their threads, since what they counted still counts.
+        // FIXME: Destroy at program end to avoid leak.
+        static AJG_SYNTH_THREAD_LOCAL shard_type* shard = 0;
+        if (shard == 0) {
+            shard = new shard_type;
+            std::lock_guard<std::mutex> const lock(mutex());
+            shards().push_back(shard);
+        }
+        return *shard;
+    #endif
+    }
+
+    inline static std::mutex&    mutex()    { static std::mutex    m; return m; }
+    inline static registry_type& registry() { static registry_type r; return r; }
+    inline static shards_type&   shards()   { static shard_type retired; static shards_type s(1, &retired); return s; }
+
+    inline static std::string format_number(double const number) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.15g", number);
+        return buffer;
+    }
+
+    inline static std::string prometheus_labels(labels_type const& labels) {
+        if (labels.empty()) {
+            return std::string();
+        }
+
+        std::string text = "{";
+        for (std::size_t i = 0; i < labels.size(); ++i) {
+            text += (i ? "," : "") + labels[i].first + "=\"";
+
+            for (char const c : labels[i].second) {
+                switch (c) {
+                case '\\': text += "\\\\"; break;
+                case '"':  text += "\\\""; break;
+                case '\n': text += "\\n";  break;
+                default:   text += c;
+                }
+            }
+            text += '"';
+        }
+        return text + '}';
+    }
+
+    inline static std::string json_string(std::string const& s) {
+        std::string text = "\"";
+        for (char const c : s) {
+            switch (c) {
+            case '\\': text += "\\\\"; break;
+            case '"':  text += "\\\""; break;
+            case '\n': text += "\\n";  break;
+            case '\t': text += "\\t";  break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned>(c));
+                    text += buffer;
+                }
+                else {
+                    text += c;
+                }
+            }
+        }
+        return text + '"';
+    }
+};
+
+}} // namespace ajg::synth
+
+#endif // AJG_SYNTH_METRICS_HPP_INCLUDED
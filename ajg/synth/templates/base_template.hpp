@@ -6,20 +6,25 @@
 #define AJG_SYNTH_TEMPLATES_BASE_TEMPLATE_HPP_INCLUDED
 
 #include <map>
+#include <atomic>
 #include <string>
 #include <cerrno>
 #include <fstream>
 #include <sstream>
 #include <utility>
+#include <iterator>
 #include <stdexcept>
+#include <sys/stat.h>
 
 #include <boost/optional.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/utility/in_place_factory.hpp>
 
+#include <ajg/synth/metrics.hpp>
 #include <ajg/synth/exceptions.hpp>
 #include <ajg/synth/value_traits.hpp>
+#include <ajg/synth/detail/string_streambuf.hpp>
 
 namespace ajg {
 namespace synth {
@@ -40,6 +45,9 @@ struct base_template : boost::noncopyable {
 
     typedef typename kernel_type::range_type                                    range_type;
     typedef typename kernel_type::state_type                                    state_type;
+    typedef typename state_type::dependencies_type                              dependencies_type;
+    typedef typename state_type::inheritance_type                               inheritance_type;
+    typedef typename state_type::footprint_type                                 footprint_type;
 
     typedef typename engine_type::value_type                                    value_type;
     typedef typename engine_type::context_type                                  context_type;
@@ -64,7 +72,7 @@ struct base_template : boost::noncopyable {
 
   protected:
 
-    base_template() {}
+    base_template() : render_seconds_(unnamed_render_seconds()), typical_size_(0) {}
 
   public:
 
@@ -74,7 +82,9 @@ struct base_template : boost::noncopyable {
 
     inline void render_to_stream(ostream_type& ostream, context_type& context) const {
         ostream.imbue(traits_type::standard_locale());
-        this->kernel().render(ostream, this->options(), this->state(), context);
+        this->with_snapshot(ostream, context, [&] {
+            this->kernel().render(ostream, this->options(), this->state(), context);
+        });
     }
 
     inline void render_to_stream(ostream_type& ostream, data_type const& data) const {
@@ -82,14 +92,28 @@ struct base_template : boost::noncopyable {
         this->render_to_stream(ostream, context);
     }
 
+    // Also collects the paths of the files this template read, whether linked or while rendering.
+    inline void render_to_stream(ostream_type& ostream, data_type const& data, paths_type& dependencies) const {
+        context_type context(data, this->options().metadata);
+        context.dependencies(&dependencies);
+
+        for (auto const& dependency : this->dependencies()) {
+            context.add_dependency(dependency.first);
+        }
+        this->render_to_stream(ostream, context);
+    }
+
 //
-// render_to_string
+// render_to_string, render_to_buffer:
+//     The latter renders into an existing string, replacing its contents but keeping its storage,
+//     so that callers can reuse one; either way, the string is reserved ahead of time according
+//     to the sizes of recent renders, and is written to directly rather than copied afterwards.
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
     inline string_type render_to_string(context_type& context) const {
-        std::basic_ostringstream<char_type> oss;
-        this->render_to_stream(oss, context);
-        return oss.str();
+        string_type buffer;
+        this->render_to_buffer(buffer, context);
+        return buffer;
     }
 
     inline string_type render_to_string(data_type const& data) const {
@@ -97,6 +121,55 @@ struct base_template : boost::noncopyable {
         return this->render_to_string(context);
     }
 
+    inline void render_to_buffer(string_type& buffer, context_type& context) const {
+        buffer.clear();
+        buffer.reserve(this->typical_size_.load(std::memory_order_relaxed) * 9 / 8);
+        {
+            detail::string_streambuf<char_type> streambuf(buffer);
+            ostream_type ostream(&streambuf);
+            this->render_to_stream(ostream, context);
+        }
+        this->record_size(buffer.size());
+    }
+
+    inline void render_to_buffer(string_type& buffer, data_type const& data) const {
+        context_type context(data, this->options().metadata);
+        this->render_to_buffer(buffer, context);
+    }
+
+//
+// render_block_to_stream, render_block_to_string:
+//     Render only the named block, as the template's ancestry (if any) would have it rendered,
+//     without evaluating anything outside of it; only supported by engines that have blocks.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline void render_block_to_stream(string_type const& name, ostream_type& ostream, context_type& context) const {
+        ostream.imbue(traits_type::standard_locale());
+        this->with_snapshot(ostream, context, [&] {
+            this->kernel().render_named_block(ostream, this->options(), this->state(), name, context);
+        });
+    }
+
+    inline void render_block_to_stream(string_type const& name, ostream_type& ostream, data_type const& data) const {
+        context_type context(data, this->options().metadata);
+        this->render_block_to_stream(name, ostream, context);
+    }
+
+    inline string_type render_block_to_string(string_type const& name, context_type& context) const {
+        string_type buffer;
+        {
+            detail::string_streambuf<char_type> streambuf(buffer);
+            ostream_type ostream(&streambuf);
+            this->render_block_to_stream(name, ostream, context);
+        }
+        return buffer;
+    }
+
+    inline string_type render_block_to_string(string_type const& name, data_type const& data) const {
+        context_type context(data, this->options().metadata);
+        return this->render_block_to_string(name, context);
+    }
+
 //
 // render_to_path
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -122,28 +195,147 @@ struct base_template : boost::noncopyable {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+    // What this template is known as (e.g. in metrics), if anything; namely, its path.
+    inline std::string  const& name()    const { return this->name_; }
     inline string_type         str()     const { return string_type(this->range().first, this->range().second); }
     inline range_type   const& range()   const { return this->state().range(); }
     inline options_type const& options() const { return this->state().options(); }
 
+    // Files this template was linked against, as they were at parse time.
+    inline dependencies_type const& dependencies() const { return this->state().dependencies(); }
+
+    // Block overrides resolved along with this template's ancestors, if any.
+    inline inheritance_type const& inheritance() const { return this->state().inheritance(); }
+
+    // Whether rendering this template only affects its output, as far as could be told when it was
+    // parsed; only known when parsed for rendering concurrently (see include_concurrency, etc.)
+    inline boolean_type isolated() const { return this->state().is_isolated(this->state().match()); }
+
+    // Approximately how many bytes this template retains; see footprint.
+    inline footprint_type footprint() const {
+        footprint_type result = this->state().footprint();
+        range_type const& range = this->range();
+        result.source = range.first == range.second ? 0 : std::distance(range.first, range.second) * sizeof(char_type);
+        result.other += footprint_type::string(this->name_);
+        return result;
+    }
+
     inline static void prime() {
         template_type::kernel();
     }
 
   protected:
 
+    inline static boolean_type changed(path_type const& path, struct stat const& previous) {
+        struct stat stats;
+
+        if (stat(text::narrow(path).c_str(), &stats) == 0) {
+            return previous.st_mtime < stats.st_mtime
+                || previous.st_size != stats.st_size;
+        }
+
+        return true; // File may have been deleted, etc.
+    }
+
+    inline boolean_type stale_dependencies() const {
+        for (auto const& dependency : this->dependencies()) {
+            if (template_type::changed(dependency.first, dependency.second)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     inline void reset(options_type const& options = options_type()) {
         this->state_ = boost::in_place(range_type(), options);
         // NOTE: Don't parse in this case.
     }
 
     inline void reset(iterator_type const& begin, iterator_type const& end, options_type const& options = options_type()) {
+        static metrics::series const parse_seconds = metrics::histogram("synth_parse_seconds", labels());
+        static AJG_SYNTH_THREAD_LOCAL std::size_t depth = 0; // Nested (e.g. linked) templates' failures count once.
         this->state_ = boost::in_place(range_type(begin, end), options);
-        this->kernel().parse(this->state_.get_ptr());
+        metrics::clock_type::time_point const start = metrics::clock_type::now();
+        ++depth;
+        try {
+            this->kernel().parse(this->state_.get_ptr());
+        }
+        catch (std::exception const& e) {
+            if (--depth == 0) {
+                metrics::count_exception(e);
+            }
+            throw;
+        }
+        catch (...) {
+            --depth;
+            throw;
+        }
+        --depth;
+        metrics::observe_since(parse_seconds, start);
+    }
+
+    // Only the first `max_named_series` templates get latencies of their own; the rest are
+    // lumped together as template="(other)", so that the series (which are never released) and
+    // each thread's shard of them stay bounded however many templates there are.
+    inline void name(std::string const& name) {
+        static std::size_t const max_named_series = 256;
+        metrics::labels_type named = labels(), other = labels();
+        named.push_back(std::make_pair("template", name));
+        other.push_back(std::make_pair("template", "(other)"));
+        this->render_seconds_ = metrics::histogram("synth_render_seconds", named, other, max_named_series);
+        this->name_ = name;
     }
 
   private:
 
+    // Nested (e.g. included) templates share the outermost one's clock, and count towards its metrics.
+    template <class Render>
+    inline void with_snapshot(ostream_type& ostream, context_type& context, Render const& render) const {
+        if (context.snapshot()) {
+            render();
+            return;
+        }
+
+        static metrics::series const rendered_bytes = metrics::counter("synth_rendered_bytes_total", labels());
+        std::streamoff const before = ostream.tellp();
+        metrics::clock_type::time_point const start = metrics::clock_type::now();
+        context.snapshot(traits_type::utc_time());
+        try {
+            render();
+        }
+        catch (std::exception const& e) {
+            context.snapshot(boost::none);
+            metrics::count_exception(e);
+            throw;
+        }
+        catch (...) {
+            context.snapshot(boost::none);
+            throw;
+        }
+        context.snapshot(boost::none);
+
+        std::streamoff const after = ostream.tellp();
+        if (before != -1 && after != -1) {
+            metrics::count(rendered_bytes, double(after - before));
+        }
+        metrics::observe_since(this->render_seconds_, start);
+    }
+
+    inline static metrics::labels_type labels() {
+        return metrics::labels_type(1, std::make_pair("engine", engine_type::name()));
+    }
+
+    inline static metrics::series unnamed_render_seconds() {
+        static metrics::series const series = metrics::histogram("synth_render_seconds", labels());
+        return series;
+    }
+
+    // Keeps a moving average of the output's size, weighing the latest render by a quarter.
+    inline void record_size(std::size_t const size) const {
+        std::size_t const typical = this->typical_size_.load(std::memory_order_relaxed);
+        this->typical_size_.store(typical == 0 ? size : (typical * 3 + size) / 4, std::memory_order_relaxed);
+    }
+
     inline static kernel_type const& kernel() {
         static kernel_type const kernel;
         return kernel;
@@ -154,7 +346,10 @@ struct base_template : boost::noncopyable {
 
   private:
 
-    boost::optional<state_type> state_;
+    boost::optional<state_type>      state_;
+    std::string                      name_;
+    metrics::series                  render_seconds_;
+    mutable std::atomic<std::size_t> typical_size_;
 };
 
 }}} // namespace ajg::synth::templates
@@ -72,7 +72,7 @@ struct buffer_template : base_template<Engine, typename Engine::traits_type::cha
 
     inline boolean_type stale(buffer_type const& buffer, options_type const& options) const {
         AJG_SYNTH_ASSERT(this->same(buffer, options));
-        return false;
+        return this->stale_dependencies();
     }
 
   private:
@@ -53,6 +53,7 @@ struct path_template : base_template<Engine, boost::spirit::classic::file_iterat
 
     path_template(path_type const& path, options_type const& options = options_type())
             : source_(path), info_(locate_file(path, options.directories)) {
+        this->name(text::narrow(path));
         if (this->info_.second.st_size == 0) { // Empty file.
             this->reset(options);
         }
@@ -116,14 +117,7 @@ struct path_template : base_template<Engine, boost::spirit::classic::file_iterat
 
     inline boolean_type stale(path_type const& path, options_type const& options) const {
         AJG_SYNTH_ASSERT(this->same(path, options));
-        struct stat stats;
-
-        if (stat(text::narrow(this->info_.first).c_str(), &stats) == 0) {
-            return this->info_.second.st_mtime < stats.st_mtime
-                || this->info_.second.st_size != stats.st_size;
-        }
-
-        return true; // File may have been deleted, etc.
+        return this->changed(this->info_.first, this->info_.second) || this->stale_dependencies();
     }
 
   private:
@@ -50,7 +50,7 @@ struct string_template : base_template<Engine, typename Engine::traits_type::str
 
     inline boolean_type stale(string_type const& source, options_type const& options) const {
         AJG_SYNTH_ASSERT(this->same(source, options));
-        return false;
+        return this->stale_dependencies();
     }
 
   private:
@@ -5,15 +5,21 @@
 #ifndef AJG_SYNTH_VALUE_ITERATOR_HPP_INCLUDED
 #define AJG_SYNTH_VALUE_ITERATOR_HPP_INCLUDED
 
-#include <boost/iterator/iterator_facade.hpp>
+#include <new>
+#include <vector>
+#include <type_traits>
 
-#include <ajg/synth/detail/clone_ptr.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/type_traits/remove_const.hpp>
+#include <boost/iterator/iterator_facade.hpp>
 
 namespace ajg {
 namespace synth {
 
 //
-// value_iterator
+// value_iterator:
+//     Type-erases any forward iterator; small ones are stored inline rather than on the heap, and
+//     iterators into vectors of values (i.e. sequences) are stored directly, with no indirection.
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 template <class Value>
@@ -23,6 +29,15 @@ struct value_iterator
                             , boost::forward_traversal_tag
                             , Value // This forces the 'reference' type to be
                             > {     // a real Value, not an actual reference.
+  private:
+
+    typedef typename boost::remove_const<Value>::type                           element_type;
+    typedef typename std::vector<element_type>::const_iterator                  position_type;
+
+    struct virtual_iterator;
+    static std::size_t const storage_size = 5 * sizeof(void*);
+    typedef typename std::aligned_storage<storage_size>::type                   storage_type;
+
   public:
 
  // typedef std::size_t size_type;
@@ -30,38 +45,136 @@ struct value_iterator
 
   public:
 
-    value_iterator() : iterator_() {}
+    value_iterator() : iterator_(0), position_(), direct_(false) {}
 
     // explicit value_iterator(Value *const value) : value_(value) {}
 
     template <class ForwardIterator>
-    value_iterator(ForwardIterator const& iterator)
-        : iterator_(new polymorphic_iterator<ForwardIterator>(iterator)) {}
+    value_iterator(ForwardIterator const& iterator) : iterator_(0), position_(), direct_(false) {
+        this->assign(iterator);
+    }
 
-    /*template <class V>
-    value_iterator(value_iterator<V> const& other) : iterator_(new ...) {}
-*/
+    value_iterator(value_iterator const& that) : iterator_(0), position_(that.position_), direct_(that.direct_) {
+        this->iterator_ = that.iterator_ ? that.iterator_->clone(&this->storage_) : 0;
+    }
 
+    value_iterator& operator =(value_iterator const& that) {
+        if (this != &that) {
+            this->destroy();
+            this->iterator_ = that.iterator_ ? that.iterator_->clone(&this->storage_) : 0;
+            this->position_ = that.position_;
+            this->direct_   = that.direct_;
+        }
+        return *this;
+    }
 
+    ~value_iterator() { this->destroy(); }
 
   // private:
 
     template <class V>
     bool equal(value_iterator<V> const& that) const {
-        bool const a = this->iterator_, b = that.iterator_;
+        if (this->direct_ || that.direct_) {
+            return this->direct_ == that.direct_ && this->position_ == that.position_;
+        }
+        bool const a = this->iterator_ != 0, b = that.iterator_ != 0;
         return (!a && !b) || (a && b && this->iterator_->equal(*that.iterator_));
     }
 
-    void increment() { AJG_SYNTH_ASSERT(iterator_); iterator_->increment(); }
-    Value dereference() const { AJG_SYNTH_ASSERT(iterator_); return iterator_->dereference(); }
+    void increment() {
+        if (this->direct_) {
+            ++this->position_;
+        }
+        else {
+            AJG_SYNTH_ASSERT(iterator_);
+            iterator_->increment();
+        }
+    }
+
+    Value dereference() const {
+        if (this->direct_) {
+            return *this->position_;
+        }
+        AJG_SYNTH_ASSERT(iterator_);
+        return iterator_->dereference();
+    }
+
     // value_iterator advance(size_type const distance) const;
 
+  private:
+
+    template <class ForwardIterator>
+    inline void assign(ForwardIterator const& iterator) {
+        typedef typename std::vector<element_type>::iterator mutable_position_type;
+        static bool const direct = boost::is_same<ForwardIterator, position_type>::value
+                                || boost::is_same<ForwardIterator, mutable_position_type>::value;
+        this->assign(iterator, std::integral_constant<bool, direct>());
+    }
+
+    template <class ForwardIterator>
+    inline void assign(ForwardIterator const& iterator, std::true_type) {
+        this->position_ = iterator;
+        this->direct_   = true;
+    }
+
+    template <class ForwardIterator>
+    inline void assign(ForwardIterator const& iterator, std::false_type) {
+        this->iterator_ = make<polymorphic_iterator<ForwardIterator> >(&this->storage_, iterator);
+    }
+
+    // Converting between constness only needs to convert the direct position, if any.
+    template <class V>
+    inline void assign(value_iterator<V> const& iterator) {
+        if (iterator.direct_) {
+            this->position_ = iterator.position_;
+            this->direct_   = true;
+        }
+        else if (iterator.iterator_) {
+            this->assign(iterator, std::false_type());
+        }
+    }
+
+//
+// make:
+//     Constructs an iterator inline, within storage, when it fits, or on the heap otherwise; the
+//     choice is made at compile-time so that only the applicable placement is ever instantiated.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    template <class T>
+    struct fits : std::integral_constant<bool, sizeof(T) <= storage_size
+                                            && std::alignment_of<T>::value <= std::alignment_of<storage_type>::value> {};
+
+    template <class T, class ForwardIterator>
+    inline static T* make(storage_type* const storage, ForwardIterator const& iterator) {
+        return make<T>(storage, iterator, fits<T>());
+    }
+
+    template <class T, class ForwardIterator>
+    inline static T* make(storage_type* const storage, ForwardIterator const& iterator, std::true_type) {
+        return new (storage) T(iterator);
+    }
+
+    template <class T, class ForwardIterator>
+    inline static T* make(storage_type* const, ForwardIterator const& iterator, std::false_type) {
+        return new T(iterator);
+    }
+
+    inline void destroy() {
+        if (this->iterator_ == static_cast<void*>(&this->storage_)) {
+            this->iterator_->~virtual_iterator();
+        }
+        else {
+            delete this->iterator_;
+        }
+        this->iterator_ = 0;
+    }
+
   private:
 
     struct virtual_iterator {
         virtual void increment() = 0;
         virtual Value dereference() const = 0;
-        virtual virtual_iterator& clone() const = 0;
+        virtual virtual_iterator* clone(storage_type* const storage) const = 0;
         virtual bool equal(virtual_iterator const& that) const = 0;
         virtual ~virtual_iterator() {}
     };
@@ -72,7 +185,9 @@ struct value_iterator
 
         virtual void increment() { iterator_++; }
         virtual Value dereference() const { return *iterator_; }
-        virtual polymorphic_iterator& clone() const { return *new polymorphic_iterator(iterator_); }
+        virtual polymorphic_iterator* clone(storage_type* const storage) const {
+            return value_iterator::template make<polymorphic_iterator>(storage, iterator_);
+        }
         virtual bool equal(virtual_iterator const& that) const {
          // AJG_SYNTH_ASSERT(typeid(polymorphic_iterator) == typeid(that));
             AJG_SYNTH_ASSERT(dynamic_cast<polymorphic_iterator const*>(&that));
@@ -87,7 +202,11 @@ struct value_iterator
 
     friend class boost::iterator_core_access;
     template <class> friend struct value_iterator;
-    detail::clone_ptr<virtual_iterator> iterator_;
+
+    virtual_iterator* iterator_; // Points into storage_ when small enough, or to the heap otherwise.
+    position_type     position_; // Used instead when direct_.
+    bool              direct_;
+    storage_type      storage_;
 };
 
 
@@ -10,6 +10,7 @@
 #include <vector>
 #include <string>
 #include <ctime>
+#include <mutex>
 #include <cctype>
 #include <cstring>
 #include <istream>
@@ -20,6 +21,7 @@
 #include <boost/none_t.hpp>
 #include <boost/cstdint.hpp>
 #include <boost/optional.hpp>
+#include <boost/type_traits/is_integral.hpp>
 
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -27,6 +29,7 @@
 
 #include <ajg/synth/value_iterator.hpp>
 #include <ajg/synth/detail/text.hpp>
+#include <ajg/synth/detail/format_number.hpp>
 
 //
 // TODO: Construct a consistent taxonomy--
@@ -180,6 +183,10 @@ struct default_traits {
         return datetime_type(utc_time(), utc_timezone().second);
     }
 
+    inline static datetime_type utc_datetime(time_type const& utc) {
+        return datetime_type(utc, utc_timezone().second);
+    }
+
 ///
 /// local_datetime
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -188,6 +195,12 @@ struct default_traits {
         return boost::local_time::local_sec_clock::local_time(timezone.second);
     }
 
+    inline static datetime_type local_datetime(timezone_type const& timezone, time_type const& utc) {
+        // Truncated to the second, like local_sec_clock.
+        time_type const seconds(utc.date(), self_type::to_duration(0, 0, utc.time_of_day().total_seconds()));
+        return datetime_type(seconds, timezone.second);
+    }
+
 ///
 /// utc_timezone:
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -298,15 +311,12 @@ struct default_traits {
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
     inline static timezone_type to_region_timezone(region_type const& region) {
-        static boost::local_time::tz_database const tz_db(self_type::load_tz_db());
-
         if (region.empty()) {
             return self_type::empty_timezone();
         }
 
         AJG_SYNTH_ASSERT(self_type::is_region(region));
-
-        return timezone_type(region, tz_db.time_zone_from_region(text::narrow(region)));
+        return self_type::interned_timezone(region, &self_type::make_region_timezone);
     }
 
     inline static timezone_type to_posix_timezone(string_type const& posix_string) {
@@ -315,8 +325,43 @@ struct default_traits {
         }
 
         AJG_SYNTH_ASSERT(!self_type::is_region(posix_string));
+        return self_type::interned_timezone(posix_string, &self_type::make_posix_timezone);
+    }
+
+///
+/// interned_timezone:
+///     Zones are immutable once constructed, so each distinct region or POSIX spec is only ever
+///     parsed once per process and the same pointer is shared by every caller, in any thread.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    inline static timezone_type interned_timezone(string_type const& s, timezone_type (*make)(string_type const&)) {
+        typedef std::map<string_type, timezone_type> timezones_type;
+        static std::size_t const max_timezones = 1024; // Specs can come from data, so keep this bounded.
+        static std::mutex mutex;
+        static timezones_type timezones;
+
+        {
+            std::lock_guard<std::mutex> const lock(mutex);
+            typename timezones_type::const_iterator const it = timezones.find(s);
+            if (it != timezones.end()) {
+                return it->second;
+            }
+        }
 
-        // TODO: Consider using caching here (even thread-locally) to reduce allocations.
+        timezone_type const timezone = make(s); // Parse outside the lock; it may throw.
+        std::lock_guard<std::mutex> const lock(mutex);
+        if (timezones.size() >= max_timezones) {
+            timezones.clear();
+        }
+        return timezones.insert(std::make_pair(s, timezone)).first->second;
+    }
+
+    inline static timezone_type make_region_timezone(string_type const& region) {
+        static boost::local_time::tz_database const tz_db(self_type::load_tz_db());
+        return timezone_type(region, tz_db.time_zone_from_region(text::narrow(region)));
+    }
+
+    inline static timezone_type make_posix_timezone(string_type const& posix_string) {
         boost::local_time::time_zone_ptr const ptr(new boost::local_time::posix_time_zone(text::narrow(posix_string)));
         return timezone_type(region_type(), ptr);
     }
@@ -604,6 +649,129 @@ struct default_traits {
         AJG_SYNTH_ASSERT(stream);
         return stream.str();
     }
+
+///
+/// format_clock:
+///     Memoizes formatting a clock reading, per formatter, format and zone, for as long as it
+///     stays within the same second; pages rendered within the same second all show the same
+///     current time, so it is only ever computed once per second process-wide.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    typedef string_type (*clock_formatter_type)(string_type const&, datetime_type const&);
+
+    inline static string_type format_clock( clock_formatter_type const  formatter
+                                          , string_type          const& format
+                                          , timezone_type        const& timezone
+                                          , datetime_type        const& datetime
+                                          ) {
+        typedef std::pair<clock_formatter_type, std::pair<string_type, void const*> > key_type;
+        typedef struct {
+            time_type     second;
+            timezone_type timezone; // Keeps the zone, and hence its address in the key, alive.
+            string_type   text;
+        }                                                                       entry_type;
+        typedef std::map<key_type, entry_type>                                  entries_type;
+
+        static std::size_t const max_entries = 256;
+        static std::mutex mutex;
+        static entries_type entries;
+
+        time_type const utc = datetime.utc_time();
+        time_type const second(utc.date(), self_type::to_duration(0, 0, utc.time_of_day().total_seconds()));
+        key_type const key(formatter, std::make_pair(format, static_cast<void const*>(timezone.second.get())));
+
+        {
+            std::lock_guard<std::mutex> const lock(mutex);
+            typename entries_type::const_iterator const it = entries.find(key);
+            if (it != entries.end() && it->second.second == second) {
+                return it->second.text;
+            }
+        }
+
+        entry_type const entry = { second, timezone, formatter(format, datetime) };
+        std::lock_guard<std::mutex> const lock(mutex);
+        if (entries.size() >= max_entries) {
+            entries.clear();
+        }
+        return (entries[key] = entry).text;
+    }
+
+///
+/// format_number, format_fixed:
+///     Produce the same text as streaming the number out under standard_locale() with default
+///     flags (or std::fixed and the given precision, respectively) but without involving a stream.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    template <class Number>
+    inline static string_type format_number(Number const number, int const precision = 6) {
+        string_type s;
+        if (!self_type::standard_numbers()) {
+            std::basic_ostringstream<char_type> stream;
+            stream.imbue(self_type::standard_locale());
+            stream << std::setprecision(precision) << number;
+            return stream.str();
+        }
+        return self_type::append_number(s, number, precision), s;
+    }
+
+    inline static string_type format_fixed(floating_type const number, int const precision) {
+        string_type s;
+        if (!self_type::standard_numbers()) {
+            std::basic_ostringstream<char_type> stream;
+            stream.imbue(self_type::standard_locale());
+            stream << std::fixed << std::setprecision(precision) << number;
+            return stream.str();
+        }
+        return detail::format_floating(s, number, precision, 'f'), s;
+    }
+
+///
+/// output_number:
+///     Equivalent to `ostream << number` for streams already imbued with standard_locale(); the
+///     stream is only used directly when its flags call for more than the default formatting.
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    template <class Number>
+    inline static void output_number(ostream_type& ostream, Number const number) {
+        std::ios_base::fmtflags const relevant
+            = std::ios_base::basefield | std::ios_base::floatfield | std::ios_base::showbase
+            | std::ios_base::showpoint | std::ios_base::showpos   | std::ios_base::uppercase;
+
+        if ((ostream.flags() & relevant) != std::ios_base::dec || ostream.width() != 0 || !self_type::standard_numbers()) {
+            ostream << number;
+        }
+        else {
+            string_type s;
+            self_type::append_number(s, number, static_cast<int>(ostream.precision()));
+            ostream.write(s.data(), s.size());
+        }
+    }
+
+  private:
+
+    template <class Number>
+    inline static void append_number(string_type& s, Number const number, int const precision) {
+        self_type::append_number(s, number, precision, boost::is_integral<Number>());
+    }
+
+    template <class Number>
+    inline static void append_number(string_type& s, Number const number, int, boost::true_type) {
+        char_type buffer[detail::integer_digits];
+        char_type* const end = buffer + detail::integer_digits;
+        s.append(detail::format_integer(end, number), end);
+    }
+
+    template <class Number>
+    inline static void append_number(string_type& s, Number const number, int const precision, boost::false_type) {
+        detail::format_floating(s, number, precision);
+    }
+
+    inline static boolean_type standard_numbers() {
+        // Whether standard_locale() formats numbers like the classic one, which is what the above assume.
+        static boolean_type const b = std::use_facet<std::numpunct<char_type> >(standard_locale()).decimal_point() == char_type('.')
+                                   && std::use_facet<std::numpunct<char_type> >(standard_locale()).grouping().empty();
+        return b;
+    }
 };
 
 }} // namespace ajg::synth
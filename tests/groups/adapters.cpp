@@ -2,6 +2,8 @@
 //  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
 //  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
 
+#include <list>
+
 #include <boost/array.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
@@ -9,6 +11,7 @@
 #include <boost/shared_array.hpp>
 
 #include <boost/assign/list_of.hpp>
+#include <boost/iterator/iterator_adaptor.hpp>
 
 #include <ajg/synth/testing.hpp>
 #include <ajg/synth/adapters.hpp>
@@ -31,8 +34,39 @@ typedef traits_type::char_type
 typedef traits_type::string_type                                                string_type;
 typedef s::detail::text<string_type>                                            text;
 
+typedef value_type::const_iterator                                              value_iterator_type;
+
 AJG_SYNTH_TEST_GROUP("adapter");
 
+// An iterator too large for value_iterator to store inline.
+struct padded_iterator : boost::iterator_adaptor<padded_iterator, std::list<int>::const_iterator> {
+    padded_iterator() : padding() {}
+    explicit padded_iterator(std::list<int>::const_iterator const& it) : padded_iterator::iterator_adaptor_(it), padding() {}
+    char padding[64];
+};
+
+string_type join(value_iterator_type it, value_iterator_type const& end) {
+    string_type result;
+    for (; it != end; ++it) result += (*it).to_string();
+    return result;
+}
+
+// Iterates, copies and assigns value_iterators over [begin, end), which should yield "123".
+template <class Iterator>
+void check_value_iterator(Iterator const& begin, Iterator const& end) {
+    value_iterator_type const first(begin), last(end);
+    value_iterator_type copy(first), assigned;
+
+    MUST_EQUAL(join(first, last), "123");
+    MUST(copy == first);
+    ++copy;
+    MUST(copy != first); // Copies advance independently.
+    assigned = copy;
+    MUST(assigned == copy);
+    MUST_EQUAL(join(assigned, last), "23");
+    MUST_EQUAL(join(first, last), "123");
+}
+
 } // namespace
 
 AJG_SYNTH_TEST_UNIT(assignments) {
@@ -122,3 +156,94 @@ AJG_SYNTH_TEST_UNIT(assignments) {
     char_type const *const ccc = sss.c_str();
     context.set(text::literal("char_pointer"), ccc);
 }}}
+
+AJG_SYNTH_TEST_UNIT(value_iterator inline) {
+    std::list<int> const list = boost::assign::list_of(1)(2)(3);
+    check_value_iterator(list.begin(), list.end());
+}}}
+
+AJG_SYNTH_TEST_UNIT(value_iterator heap) {
+    std::list<int> const list = boost::assign::list_of(1)(2)(3);
+    MUST(sizeof(padded_iterator) > 5 * sizeof(void*));
+    check_value_iterator(padded_iterator(list.begin()), padded_iterator(list.end()));
+}}}
+
+AJG_SYNTH_TEST_UNIT(value_iterator direct) {
+    std::vector<value_type> const vector = boost::assign::list_of(value_type(1))(value_type(2))(value_type(3));
+    check_value_iterator(vector.begin(), vector.end());
+}}}
+
+AJG_SYNTH_TEST_UNIT(json) {
+    s::detail::json_document const document(std::string(
+        "{\"s\": \"a\\u00e9\\\"b\", \"n\": -42, \"f\": 2.5, \"t\": true, \"z\": null,"
+        " \"xs\": [1, [2, 3], {\"k\": \"v\"}], \"o\": {\"p\": {\"q\": 7}}, \"e\": {}, \"d\": 1, \"d\": 2}"));
+    value_type const value((s::detail::json_value(&document, 0)));
+
+    MUST(value.is_associative());
+    MUST_EQUAL(value.attribute(text::literal("s"))->to_string(), "a\xc3\xa9\"b");
+    MUST_EQUAL(value.attribute(text::literal("n"))->to_integer(), -42);
+    MUST_EQUAL(value.attribute(text::literal("f"))->to_floating(), 2.5);
+    MUST(value.attribute(text::literal("t"))->is_boolean());
+    MUST(value.attribute(text::literal("z"))->is_unit());
+    MUST_EQUAL(value.attribute(text::literal("xs"))->size(), 3U);
+    MUST_EQUAL((*value.attribute(text::literal("xs")))[value_type(1)].to_string(), "2, 3");
+    MUST_EQUAL(value.attribute(text::literal("o"))->attribute(text::literal("p"))->attribute(text::literal("q"))->to_integer(), 7);
+    MUST_NOT(value.attribute(text::literal("e"))->to_boolean());
+    MUST_EQUAL(value.attribute(text::literal("d"))->to_integer(), 2); // Later duplicates win.
+    MUST(!value.attribute(text::literal("missing")));
+}}}
+
+AJG_SYNTH_TEST_UNIT(json numbers) {
+    s::detail::json_document const document(std::string(
+        "{\"p\": 1234567.89, \"e\": 1.50E+2, \"i\": 12345678901234567890, \"h\": 1e999, \"n\": -0}"));
+    value_type const value((s::detail::json_value(&document, 0)));
+
+    // Numbers are output as written, but compared and computed with by value.
+    MUST_EQUAL(value.attribute(text::literal("p"))->to_string(), "1234567.89");
+    MUST_EQUAL(value.attribute(text::literal("e"))->to_string(), "1.50E+2");
+    MUST(*value.attribute(text::literal("e")) == value_type(150));
+    MUST_NOT(value.attribute(text::literal("n"))->to_boolean());
+    MUST_EQUAL(value.attribute(text::literal("n"))->to_string(), "-0");
+
+    // Those out of range are kept as strings.
+    MUST(value.attribute(text::literal("i"))->is_textual());
+    MUST_EQUAL(value.attribute(text::literal("i"))->to_string(), "12345678901234567890");
+    MUST(value.attribute(text::literal("h"))->is_textual());
+    MUST_EQUAL(value.attribute(text::literal("h"))->to_string(), "1e999");
+}}}
+
+AJG_SYNTH_TEST_UNIT(json errors) {
+    std::size_t const max_depth = s::detail::json_document::max_depth;
+    s::detail::json_document const deepest(string_type(max_depth + 1, '[') + string_type(max_depth + 1, ']'));
+    MUST_THROW(s::parsing_error, s::detail::json_document(string_type(max_depth + 2, '[') + string_type(max_depth + 2, ']')));
+
+    // Leading zeros and malformed numbers.
+    s::detail::json_document const zeros(std::string("[0, -0, 0.5, 0e1]"));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("[01]")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("[-01]")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("[00.5]")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("[1.]")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("[.5]")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("[1e]")));
+
+    // Unpaired surrogates.
+    s::detail::json_document const paired(std::string("\"\\ud83d\\ude00\""));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("\"\\ud83d\"")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("\"\\ud83dx\"")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("\"\\ud83d\\u0041\"")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("\"\\ude00\"")));
+
+    // Trailing garbage.
+    s::detail::json_document const spaced(std::string(" {} \n"));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("{} x")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("[1]]")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("1 2")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("truex")));
+
+    // Truncated or otherwise malformed texts.
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("{\"a\": [1, 2}")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("{\"a\" 1}")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("[1,]")));
+    MUST_THROW(s::parsing_error, s::detail::json_document(std::string("\"abc")));
+}}}
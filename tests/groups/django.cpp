@@ -95,6 +95,17 @@ DJANGO_TEST(string, "{{_(\"Bar\")}}", "Bar")
 DJANGO_TEST(multiple filters,   "{% firstof 0|add:1|add:2|add:3 %}", "6")
 DJANGO_TEST(multiple pipelines, "{% firstof -1|add:1 2|add:-2 3 %}", "3")
 
+AJG_SYNTH_TEST_UNIT(json data) {
+    s::detail::json_document const document(std::string(
+        "{\"s\": \"a\\u00e9\\\"b\", \"n\": -42, \"f\": 2.5, \"t\": true, \"z\": null,"
+        " \"xs\": [1, [2, 3], {\"k\": \"v\"}], \"o\": {\"p\": {\"q\": 7}}, \"e\": {}}"));
+    context_type context((value_type(s::detail::json_value(&document, 0))));
+    string_template_type const t("{{ s }}|{{ n|add:1 }}|{{ f }}|{{ t }}|{{ z }}|{{ o.p.q }}|"
+                                 "{% for x in xs %}{{ x }};{% endfor %}|{% for k, v in o.p %}{{ k }}={{ v }}{% endfor %}|"
+                                 "{% if e %}full{% else %}empty{% endif %}|{{ missing }}", options);
+    MUST_EQUAL(t.render_to_string(context), "a\xc3\xa9&quot;b|-41|2.5|True|None|7|1;2, 3;k: v;|q=7|empty|");
+}}}
+
 /// Escaping tests
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -199,6 +210,7 @@ DJANGO_TEST(ifchanged_tag:content, "{% for v in heterogenous%}{% ifchanged %}{{
 DJANGO_TEST(ifchanged_tag:content, "{% for v in heterogenous%}{% ifchanged %}{{ v }}{% else %}-{% endifchanged %}{% endfor %}",       "42-foo-")
 DJANGO_TEST(ifchanged_tag:content, "{% for v in heterogenous%}{% ifchanged %}Y{% endifchanged %}{% endfor %}",                        "Y")
 DJANGO_TEST(ifchanged_tag:content, "{% for v in heterogenous%}{% ifchanged %}Y{% else %}-{% endifchanged %}{% endfor %}",             "Y---")
+DJANGO_TEST(ifchanged_tag:content, "{% for v in heterogenous%}{% ifchanged %}{% ifchanged %}{{ v }}{% endifchanged %}{% endifchanged %}{% endfor %}", "42foo")
 DJANGO_TEST(ifchanged_tag:variables, "{% for v in heterogenous%}{% ifchanged v %}Y{% endifchanged %}{% endfor %}",                    "YY")
 DJANGO_TEST(ifchanged_tag:variables, "{% for v in heterogenous%}{% ifchanged v %}Y{% else %}N{% endifchanged %}{% endfor %}",         "YNYN")
 DJANGO_TEST(ifchanged_tag:variables, "{% for v in heterogenous%}{% ifchanged v %}{{ v }}{% endifchanged %}{% endfor %}",              "42foo")
@@ -263,10 +275,23 @@ AJG_SYNTH_TEST_UNIT(now_tag) {
     MUST_EQUAL(s, text::stringize(std::localtime(&time)->tm_year + 1900));
 }}}
 
+AJG_SYNTH_TEST_UNIT(interned timezones) {
+    MUST(traits_type::to_timezone("America/New_York").second == traits_type::to_timezone("America/New_York").second);
+    MUST(traits_type::to_timezone("EST-5EDT,M3.2.0,M11.1.0").second == traits_type::to_timezone("EST-5EDT,M3.2.0,M11.1.0").second);
+    MUST_EQUAL(traits_type::to_timezone("EST-5EDT,M3.2.0,M11.1.0").second->std_zone_abbrev(), "EST");
+}}}
+
+AJG_SYNTH_TEST_UNIT(now_tag with snapshot) {
+    context.snapshot(traits_type::to_time(traits_type::to_date(2002, 1, 10), traits_type::to_duration(1, 2, 3)));
+    string_template_type const t("{% now 'Y-m-d H:i:s' %} {{ past|timesince }}", options);
+    MUST_EQUAL(t.render_to_string(context), "2002-01-10 01:02:03 0\xc2\xa0minutes");
+}}}
+
 DJANGO_TEST(regroup_tag, "{% regroup cities by country as country_list %}\n\n<ul>\n{% for country in country_list %}\n    <li>{{ country.grouper }}\n    <ul>\n        {% for item in country.list %}\n          <li>{{ item.name }}: {{ item.population }}</li>\n        {% endfor %}\n    </ul>\n    </li>\n{% endfor %}\n</ul>\n", "\n\n<ul>\n\n    <li>India\n    <ul>\n        \n          <li>Mumbai: 19,000,000</li>\n        \n          <li>Calcutta: 15,000,000</li>\n        \n    </ul>\n    </li>\n\n    <li>USA\n    <ul>\n        \n          <li>New York: 20,000,000</li>\n        \n          <li>Chicago: 7,000,000</li>\n        \n    </ul>\n    </li>\n\n    <li>Japan\n    <ul>\n        \n          <li>Tokyo: 33,000,000</li>\n        \n    </ul>\n    </li>\n\n</ul>\n")
 
 DJANGO_TEST(spaceless_tag, "{% spaceless %}\n    <p>\n        <a href=\"foo/\">Foo</a>\n    </p>\n{% endspaceless %}\n", "\n    <p><a href=\"foo/\">Foo</a></p>\n\n")
 DJANGO_TEST(spaceless_tag, "{% spaceless %}\n    <strong>\n        Hello\n    </strong>\n{% endspaceless %}\n",          "\n    <strong>\n        Hello\n    </strong>\n\n")
+DJANGO_TEST(spaceless_tag, "{% spaceless %}<a> <b>\t<c>\n</c> x </b> {{ foo }} </a> {% endspaceless %}",          "<a><b><c></c> x </b> A </a> ")
 
 DJANGO_TEST(templatetag_tag, "{% templatetag openbrace %}",     "{")
 DJANGO_TEST(templatetag_tag, "{% templatetag closevariable %}", "}}")
@@ -358,6 +383,25 @@ DJANGO_TEST(verbatim_tag, "{% verbatim %}{% for v in friends %}\n    <p>{{ v }}<
 
 DJANGO_TEST(with_tag, "[{{ls}}] {% with 'this is a long string' as ls %} {{ls}} {% endwith %} [{{ls}}]", "[]  this is a long string  []")
 
+AJG_SYNTH_TEST_UNIT(render_block) {
+    string_template_type const t("{% extends 'tests/templates/django/C.tpl' %}{% block x %}{{ block.super }}Y{% endblock x %}", options);
+    MUST_EQUAL(t.render_block_to_string("x", context), "ABCY");
+    MUST_EQUAL(t.render_to_string(context), "'ABCY'\n");
+    string_template_type const u("{{ 1|no_such_filter }}{% if False %}{% block y %}{{ foo }}{% endblock %}{% endif %}", options);
+    MUST_EQUAL(u.render_block_to_string("y", context), "A");
+    MUST_THROW(std::invalid_argument, u.render_block_to_string("z", context));
+}}}
+
+AJG_SYNTH_TEST_UNIT(render_to_buffer) {
+    string_template_type const t("{% for n in numbers %}{{ n }}{% endfor %}", options);
+    string_type buffer = "stale";
+    t.render_to_buffer(buffer, context);
+    MUST_EQUAL(buffer, "123456789");
+    t.render_to_buffer(buffer, context.data());
+    MUST_EQUAL(buffer, "123456789");
+    MUST_EQUAL(t.render_to_string(context), "123456789");
+}}}
+
 /// Filter tests
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -382,6 +426,8 @@ DJANGO_TEST(cut_filter, "{{ 'String with spaces'|cut:' ' }}", "Stringwithspaces"
 DJANGO_TEST(date_filter, "{{ past|date }}",                           "Jan 10, 2002")
 DJANGO_TEST(date_filter, "{{ before_past|date:'r' }}",                "Tue, 08 Jan 2002 13:02:03 +0000")
 DJANGO_TEST(date_filter, "{{ after_past|date:'SHORT_DATE_FORMAT' }}", "03/01/2002")
+DJANGO_TEST(date_filter, "{{ past|date:'Y' }}",                       "2002")
+DJANGO_TEST(date_filter, "{{ past|date:'D jS, g:i A (z)' }}",         "Thu 10th, 1:02 AM (10)")
 
 DJANGO_TEST(default_filter, "{{ True|default:\"default\" }}",  "True")
 DJANGO_TEST(default_filter, "{{ False|default:\"default\" }}", "default")
@@ -406,6 +452,7 @@ DJANGO_TEST(divisibleby_filter, "{{ 20|divisibleby:\"3\" }}", "False")
 
 DJANGO_TEST(escapejs_filter, "{{ haiku|escapejs }}", "Haikus are easy,\\x0ABut sometimes they don&apos;t make sense.\\x0ARefrigerator.\\x0A")
 DJANGO_TEST(escapejs_filter, "{{ haiku|escapejs|safe }}", "Haikus are easy,\\x0ABut sometimes they don't make sense.\\x0ARefrigerator.\\x0A")
+DJANGO_TEST(escapejs_filter, "{{ 'caf\xC3\xA9\t'|escapejs|safe }}", "caf\xC3\xA9\\x09") // Non-ASCII bytes are left alone.
 // DJANGO_TEST(escapejs_filter, "{{ binary_string|escapejs }}", "")
 
 DJANGO_TEST(filesizeformat_filter, "{{ 123456789|filesizeformat }}", "117.7 MB")
@@ -423,6 +470,8 @@ DJANGO_TEST(floatformat_filter, "{{34.26000|floatformat:3 }}", "34.260")
 DJANGO_TEST(floatformat_filter, "{{34.23234|floatformat:\"-3\" }}", "34.232")
 DJANGO_TEST(floatformat_filter, "{{34.00000|floatformat:\"-3\" }}", "34")
 DJANGO_TEST(floatformat_filter, "{{34.26000|floatformat:\"-3\" }}", "34.260")
+DJANGO_TEST(floatformat_filter, "{{-0.5|floatformat:1 }}",        "-0.5")
+DJANGO_TEST(floatformat_filter, "{{1234567.891|floatformat:2 }}", "1234567.89")
 
 DJANGO_TEST(getdigit_filter, "{{ 123456789|get_digit:'2' }}",  "8")
 DJANGO_TEST(getdigit_filter, "{{ -123456789|get_digit:'2' }}", "-123456789")
@@ -477,6 +526,9 @@ DJANGO_TEST(slugify_filter, "{{ '\tJoel\v is\n a\r slug\x01'|slugify }}", "joel-
 DJANGO_TEST(striptags_filter, "{{ '<b>Joel</b> <button>is</button> a <span>slug</span>'|striptags }}", "Joel is a slug")
 
 DJANGO_TEST(stringformat_filter, "{{ 255|stringformat:'x' }}", "ff")
+DJANGO_TEST(stringformat_filter, "{{ 255|stringformat:'d' }}", "255")
+DJANGO_TEST(stringformat_filter, "{{ 0.1|stringformat:'s' }}", "0.1")
+DJANGO_TEST(stringformat_filter, "{{ 1234567.0|stringformat:'s' }}", "1.23457e+06")
 
 DJANGO_TEST(time_filter, "{{ past|time }}",                           "1:02 a.m.")
 DJANGO_TEST(time_filter, "{{ before_past|time:'c' }}",                "2002-01-08T13:02:03")
@@ -632,6 +684,7 @@ DJANGO_TEST(unordered_list_filter, "{{ places|unordered_list }}", "<li>Parent\n<
 DJANGO_TEST(upper_filter, "{{ \"Joel is a slug\"|upper }}", "JOEL IS A SLUG")
 
 DJANGO_TEST(urlencode_filter, "{{ \"/this should/be encoded ^ because @ is not an option $ ()\"|urlencode }}", "/this%20should/be%20encoded%20%5E%20because%20%40%20is%20not%20an%20option%20%24%20%28%29")
+DJANGO_TEST(urlencode_filter, "{{ \"caf\xC3\xA9 & co\"|urlencode }}", "caf%C3%A9%20%26%20co")
 
 DJANGO_TEST(urlize_filter, "{{ \"This is some text containing a http://www.url.com sir and also another.url.com.\"|urlize }}", "This is some text containing a <a href='http://www.url.com'>http://www.url.com</a> sir and also <a href='http://another.url.com'>another.url.com</a>.")
 
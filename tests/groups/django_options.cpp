@@ -0,0 +1,235 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <sstream>
+
+#include <ajg/synth/cache.hpp>
+#include <ajg/synth/metrics.hpp>
+#include <ajg/synth/testing.hpp>
+#include <ajg/synth/templates.hpp>
+#include <ajg/synth/adapters.hpp>
+#include <ajg/synth/engines/django.hpp>
+
+#include <tests/data/kitchen_sink.hpp>
+
+namespace {
+
+namespace s = ajg::synth;
+
+typedef s::default_traits<char>                                                 traits_type;
+typedef s::engines::django::engine<traits_type>                                 engine_type;
+
+typedef s::templates::stream_template<engine_type>                              stream_template_type;
+typedef s::templates::string_template<engine_type>                              string_template_type;
+
+typedef engine_type::context_type                                               context_type;
+typedef engine_type::options_type                                               options_type;
+
+typedef traits_type::string_type                                                string_type;
+
+struct data_type : tests::data::kitchen_sink<engine_type> {
+    data_type() {
+        this->options.linking = true;
+    }
+};
+
+AJG_SYNTH_TEST_GROUP_WITH_DATA("django_options", data_type);
+
+} // namespace
+
+#define DJANGO_TEST(name, in, out) AJG_SYNTH_TEST_UNIT(name) { MUST_EQUAL(string_template_type(in, options).render_to_string(context), out); }}}
+
+/// Linking
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DJANGO_TEST(linked include_tag, "{% include 'tests/templates/django/variables.tpl' %}", "foo: A\nbar: B\nqux: C\n")
+DJANGO_TEST(linked include_tag, "{% include 'tests/templates/django/variables.tpl' with foo=42 only %}", "foo: 42\nbar: \nqux: \n")
+DJANGO_TEST(linked include_tag, "{% include variable_path with foo=42 only %}", "foo: 42\nbar: \nqux: \n")
+DJANGO_TEST(linked include_tag, "{% include 'tests/templates/django/variables.tpl'|lower %}", "foo: A\nbar: B\nqux: C\n")
+DJANGO_TEST(linked include_tag, "{% if false_var %}{% include 'tests/templates/django/missing.tpl' %}{% endif %}", "")
+
+DJANGO_TEST(linked extends_tag, "{% include 'tests/templates/django/derived.tpl' %}", "Base template\nBase header\nBase content + 1, 2, 3, 4, 5, 6, 7, 8, 9\nBase footer\n")
+DJANGO_TEST(linked extends_tag, "{% include 'tests/templates/django/D.tpl' %}", "'ABCD'\n")
+DJANGO_TEST(linked extends_tag, "{% extends 'tests/templates/django/A.tpl' %}\n{% block x %}Y{% endblock x %}", "'Y'\n")
+
+AJG_SYNTH_TEST_UNIT(linked dependencies) {
+    string_template_type const t("{% include 'tests/templates/django/D.tpl' %}", options);
+    MUST_EQUAL(t.dependencies().size(), 4u);
+}}}
+
+AJG_SYNTH_TEST_UNIT(unlinked dependencies) {
+    options.linking = false;
+    string_template_type const t("{% include 'tests/templates/django/D.tpl' %}", options);
+    MUST_EQUAL(t.dependencies().size(), 0u);
+}}}
+
+AJG_SYNTH_TEST_UNIT(linked overrides) {
+    string_template_type const t("{% extends 'tests/templates/django/C.tpl' %}{% block x %}{{ block.super }}Y{% endblock x %}", options);
+    MUST(t.inheritance().root);
+    MUST_EQUAL(t.inheritance().overrides.find("x")->second.size(), 4u);
+    MUST_EQUAL(t.render_to_string(context), "'ABCY'\n");
+}}}
+
+AJG_SYNTH_TEST_UNIT(linked render_block) {
+    string_template_type const t("{% extends 'tests/templates/django/C.tpl' %}{% block x %}{{ block.super }}Y{% endblock x %}", options);
+    MUST(t.inheritance().root);
+    MUST_EQUAL(t.render_block_to_string("x", context), "ABCY");
+}}}
+
+AJG_SYNTH_TEST_UNIT(linked overrides with unlinked child) {
+    context.set("parent_path", "tests/templates/django/B.tpl");
+    string_template_type const t("{% extends parent_path %}{% block x %}Z{{ block.super }}{% endblock x %}", options);
+    MUST_NOT(t.inheritance().root);
+    MUST_EQUAL(t.render_to_string(context), "'ZAB'\n");
+}}}
+
+AJG_SYNTH_TEST_UNIT(coarse clock) {
+    options.coarse_clock = true;
+    context.snapshot(traits_type::to_time(traits_type::to_date(2002, 1, 10), traits_type::to_duration(1, 2, 3)));
+    string_template_type const t("{% now 'Y-m-d' %} {% now 'Y-m-d' %} {% now 'H:i:s' %}", options);
+    MUST_EQUAL(t.render_to_string(context), "2002-01-10 2002-01-10 01:02:03");
+}}}
+
+AJG_SYNTH_TEST_UNIT(cached ssi_tag) {
+    options.caching = s::caching_mask(s::caching_files | s::caching_per_thread);
+    std::string const path = s::detail::get_current_working_directory() + "/tests/templates/django/variables.tpl";
+    string_template_type const t("{% ssi '" + path + "' %}{% ssi '" + path + "' %}", options);
+    MUST_EQUAL(t.render_to_string(context), "foo: {{ foo }}\nbar: {{ bar }}\nqux: {{ qux }}\n"
+                                            "foo: {{ foo }}\nbar: {{ bar }}\nqux: {{ qux }}\n");
+}}}
+
+AJG_SYNTH_TEST_UNIT(tracked dependencies) {
+    options.linking = false;
+    std::string const path = s::detail::get_current_working_directory() + "/tests/templates/django/variables.tpl";
+    string_template_type const t("{% include 'tests/templates/django/D.tpl' %}{% ssi '" + path + "' %}", options);
+    std::ostringstream stream;
+    std::vector<string_type> dependencies;
+    t.render_to_stream(stream, context.data(), dependencies);
+    MUST_EQUAL(dependencies.size(), 5u);
+    MUST_EQUAL(dependencies.front(), "tests/templates/django/D.tpl");
+    MUST_EQUAL(dependencies.back(), path);
+}}}
+
+AJG_SYNTH_TEST_UNIT(concurrent include_tag) {
+    options.include_concurrency = 0;
+    string_template_type const t("{% include 'tests/templates/django/variables.tpl' %}-"
+                                 "{% include 'tests/templates/django/variables.tpl' with foo=42 only %}-"
+                                 "{% include 'tests/templates/django/D.tpl' %}", options);
+    std::ostringstream stream;
+    std::vector<string_type> dependencies;
+    t.render_to_stream(stream, context.data(), dependencies);
+    MUST_EQUAL(stream.str(), "foo: A\nbar: B\nqux: C\n-foo: 42\nbar: \nqux: \n-'ABCD'\n");
+    MUST_EQUAL(dependencies.size(), 5u);
+}}}
+
+AJG_SYNTH_TEST_UNIT(concurrent include_tag not isolated) {
+    options.include_concurrency = 0;
+    // Each include's cycle carries over from one iteration to the next, so neither may be rendered apart.
+    string_template_type const t("{% for i in '123' %}{% include 'tests/templates/django/cycle.tpl' %}"
+                                 "{% include 'tests/templates/django/cycle.tpl' %}{% endfor %}", options);
+    MUST_EQUAL(t.render_to_string(context), "a\na\nb\nb\na\na\n");
+}}}
+
+AJG_SYNTH_TEST_UNIT(chunked for_tag) {
+    options.loop_concurrency = 4;
+    std::vector<int> items;
+    std::string expected, cycled;
+
+    for (int i = 0; i < 5000; ++i) {
+        items.push_back(i);
+        expected += std::to_string(i) + (i % 2 ? "B," : "A,");
+        cycled   += i % 2 ? "b" : "a";
+    }
+    context.set("items", items);
+    context.set("letter", "A");
+
+    string_template_type const t("{% for i in items %}{{ i }}{% if i|divisibleby:2 %}{{ letter }}{% else %}B{% endif %},{% endfor %}", options);
+    MUST_EQUAL(t.render_to_string(context), expected);
+    string_template_type const u("{% for i in items %}{% cycle 'a' 'b' %}{% endfor %}", options);
+    MUST_EQUAL(u.render_to_string(context), cycled);
+}}}
+
+AJG_SYNTH_TEST_UNIT(metrics) {
+    options.caching = s::caching_mask(s::caching_strings | s::caching_per_thread);
+    string_type const source = "{{ foo }}";
+    MUST_EQUAL(s::parse_template<string_template_type>(source, options)->render_to_string(context), "A");
+    MUST_EQUAL(s::parse_template<string_template_type>(source, options)->render_to_string(context), "A");
+
+    std::string const text = s::metrics::prometheus();
+    MUST(text.find("# TYPE synth_render_seconds histogram\n") != std::string::npos);
+    MUST(text.find("synth_render_seconds_bucket{engine=\"django\",le=\"+Inf\"}") != std::string::npos);
+    MUST(text.find("synth_cache_hits_total{engine=\"django\",kind=\"strings\",scope=\"per_thread\"}") != std::string::npos);
+    MUST(text.find("synth_rendered_bytes_total{engine=\"django\"}") != std::string::npos);
+    MUST_EQUAL(s::metrics::json().substr(0, 2), "{\"");
+    MUST_THROW(std::invalid_argument, s::metrics::dump("xml"));
+
+    MUST_THROW(s::parsing_error, string_template_type("{% if %}", options));
+    MUST(s::metrics::prometheus().find("\nsynth_exceptions_total{kind=\"ajg::synth::parsing_error\"} ") != std::string::npos);
+}}}
+
+AJG_SYNTH_TEST_UNIT(bounded metrics) {
+    s::metrics::labels_type const other(1, std::make_pair("t", "other"));
+    s::metrics::series const a = s::metrics::histogram("synth_test_seconds", s::metrics::labels_type(1, std::make_pair("t", "a")), other, 2);
+    s::metrics::series const b = s::metrics::histogram("synth_test_seconds", s::metrics::labels_type(1, std::make_pair("t", "b")), other, 2);
+    s::metrics::series const c = s::metrics::histogram("synth_test_seconds", s::metrics::labels_type(1, std::make_pair("t", "c")), other, 2);
+    s::metrics::series const d = s::metrics::histogram("synth_test_seconds", s::metrics::labels_type(1, std::make_pair("t", "d")), other, 2);
+    MUST_NOT_EQUAL(a.id, b.id);
+    MUST_EQUAL(c.id, d.id);
+    MUST_EQUAL(s::metrics::histogram("synth_test_seconds", s::metrics::labels_type(1, std::make_pair("t", "a")), other, 2).id, a.id);
+}}}
+
+AJG_SYNTH_TEST_UNIT(stream templates are never cached) {
+    options.caching = s::caching_mask(s::caching_all | s::caching_per_thread);
+    for (int i = 0; i < 3; ++i) {
+        std::istringstream stream("{{ foo }}" + std::to_string(i));
+        MUST_EQUAL(s::parse_template<stream_template_type>(stream, options)->render_to_string(context), "A" + std::to_string(i));
+    }
+    MUST_EQUAL(s::thread_cache<stream_template_type>().footprints().size(), 0u);
+}}}
+
+AJG_SYNTH_TEST_UNIT(metrics from finished threads) {
+    s::metrics::series const series = s::metrics::counter("synth_test_total", s::metrics::labels_type());
+    std::thread([&] { s::metrics::count(series, 2); }).join();
+    std::thread([&] { s::metrics::count(series, 3); }).join();
+    MUST(s::metrics::prometheus().find("\nsynth_test_total 5\n") != std::string::npos);
+}}}
+
+AJG_SYNTH_TEST_UNIT(footprint) {
+    options.caching = s::caching_mask(s::caching_strings | s::caching_per_thread);
+    string_type const small = "{{ foo }}", large = "{% for i in items %}{{ i|add:1 }}{% if i %}{{ foo }}{% endif %}{% endfor %}";
+    s::parse_template<string_template_type>(small, options);
+    s::parse_template<string_template_type>(large, options);
+
+    s::cache<string_template_type> const& cache = s::thread_cache<string_template_type>();
+    string_template_type::footprint_type small_footprint, large_footprint;
+
+    for (auto const& entry : cache.footprints()) {
+        if (entry.first->str() == small) small_footprint = entry.second;
+        if (entry.first->str() == large) large_footprint = entry.second;
+    }
+
+    MUST_EQUAL(small_footprint.source, small.size());
+    MUST_EQUAL(large_footprint.source, large.size());
+    MUST(small_footprint.matches > 0);
+    MUST(large_footprint.matches > small_footprint.matches);
+    MUST(cache.footprint().total() >= small_footprint.total() + large_footprint.total());
+    MUST(s::metrics::prometheus().find("synth_cache_bytes{engine=\"django\",kind=\"strings\",scope=\"per_thread\"}") != std::string::npos);
+}}}
+
+AJG_SYNTH_TEST_UNIT(parse budget) {
+    std::string unclosed;
+    for (int i = 0; i < 12; ++i) unclosed += "{% for x in y %}";
+
+    options.parse_step_limit = 2;
+    string_template_type const t("{% for x in y %}{{ x|add:1 }}{% if x %}{{ foo }}{% endif %}{% endfor %}", options);
+    MUST_EQUAL(t.render_to_string(context), "");
+    MUST_THROW(s::parsing_error, string_template_type(unclosed, options));
+
+    options.parse_step_limit = 0;
+    options.parse_time_limit = 1;
+    MUST_THROW(s::parsing_error, string_template_type(unclosed, options));
+}}}
@@ -2,12 +2,20 @@
 //  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
 //  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
 
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <sstream>
+
+#include <boost/noncopyable.hpp>
+
 #include <ajg/synth/support.hpp>
 #include <ajg/synth/testing.hpp>
 #include <ajg/synth/templates.hpp>
 #include <ajg/synth/adapters.hpp>
 #include <ajg/synth/engines/ssi.hpp>
 #include <ajg/synth/detail/find.hpp>
+#include <ajg/synth/detail/pipe.hpp>
 #include <ajg/synth/detail/filesystem.hpp>
 
 #include <tests/data/kitchen_sink.hpp>
@@ -31,6 +39,37 @@ typedef traits_type::string_type
 
 struct data_type : tests::data::kitchen_sink<engine_type> {};
 
+// A temporary directory for commands to leave traces in, removed along with them when done.
+struct scratch_directory : boost::noncopyable {
+    scratch_directory() {
+        char name[] = "/tmp/synth_tests.XXXXXX";
+        path = ::mkdtemp(name) ? name : "";
+        AJG_SYNTH_ASSERT(!path.empty());
+    }
+
+    ~scratch_directory() {
+        std::system(("rm -rf '" + path + "'").c_str());
+    }
+
+    // How many processes mentioning the directory are still running, once those killed are gone.
+    std::size_t processes() const {
+        // NOTE: Bracketing the first character keeps the pattern from matching the shell running it.
+        std::string const count = "pgrep -f '[" + path.substr(0, 1) + "]" + path.substr(1) + "' | wc -l";
+        for (int attempt = 0;; ++attempt) {
+            s::detail::pipe pipe(count);
+            std::ostringstream output;
+            pipe.read_into(output);
+            std::size_t const n = std::strtoul(output.str().c_str(), 0, 10);
+            if (n == 0 || attempt == 100) {
+                return n;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+
+    std::string path;
+};
+
 AJG_SYNTH_TEST_GROUP_WITH_DATA("ssi", data_type);
 
 } // namespace
@@ -94,6 +133,18 @@ AJG_SYNTH_TEST_UNIT(multiple set_tag) {
     MUST_EQUAL(t.render_to_string(context), "ABC");
 }}}
 
+AJG_SYNTH_TEST_UNIT(attribute names in any case) {
+    string_template_type const t(
+        "<!--#set VAR='foo' Value='A' -->"
+        "<!--#echo vAr='foo' -->");
+    MUST_EQUAL(t.render_to_string(context), "A");
+
+    string_type const error = string_template_type("<!--#echo bogus='foo' -->").render_to_string(context);
+    MUST_NOT_EQUAL(error, string_template_type("<!--#echo var='foo' -->").render_to_string(context));
+    MUST_EQUAL(string_template_type("<!--#echo va='foo' -->").render_to_string(context), error);
+    MUST_EQUAL(string_template_type("<!--#echo VARS='foo' -->").render_to_string(context), error);
+}}}
+
 AJG_SYNTH_TEST_UNIT(substitution in set_tag) {
     string_template_type const t(
         "<!--#set var='foo' value='A' -->"
@@ -110,6 +161,14 @@ AJG_SYNTH_TEST_UNIT(escaped dollar sign) {
     MUST_EQUAL(t.render_to_string(context), "$A");
 }}}
 
+AJG_SYNTH_TEST_UNIT(substitution edge cases) {
+    string_template_type const t(
+        "<!--#set var='foo' value='A' -->"
+        "<!--#set var='bar' value='a$ b${foo}c$foo.$ ${d\\$foo' -->"
+        "<!--#echo var='bar' -->");
+    MUST_EQUAL(t.render_to_string(context), "a$ bAcA.$ ${d$foo");
+}}}
+
 AJG_SYNTH_TEST_UNIT(if_tag: true) {
     string_template_type t("<!--#if expr='1' -->true<!--#endif -->");
     MUST_EQUAL(t.render_to_string(context), "true");
@@ -180,6 +239,18 @@ AJG_SYNTH_TEST_UNIT(regex substitution) {
     MUST_EQUAL(t.render_to_string(context), "oo");
 }}}
 
+AJG_SYNTH_TEST_UNIT(regex substitution reset) {
+    string_template_type t("<!--#if expr='(`foo` = /(o+)/)' --><!--#echo var='1' --><!--#endif -->"
+        "<!--#if expr='(`bar` = /ba/)' --> <!--#echo var='0' --> <!--#echo var='1' --><!--#endif -->");
+    MUST_EQUAL(t.render_to_string(context), "oo ba (none)");
+}}}
+
+AJG_SYNTH_TEST_UNIT(regex substitution shadowing) {
+    string_template_type t("<!--#set var='1' value='x' --><!--#echo var='1' -->"
+        "<!--#if expr='(`foo` = /(o+)/)' --><!--#endif --><!--#echo var='1' -->");
+    MUST_EQUAL(t.render_to_string(context), "xoo");
+}}}
+
 AJG_SYNTH_TEST_UNIT(if_elif_tag) {
     string_template_type t("<!--#if expr='' -->foo"
         "<!--#elif expr='1' -->bar<!--#endif -->");
@@ -209,10 +280,12 @@ AJG_SYNTH_TEST_UNIT(invalid if_tag: multiple expr) {
 }}}
 
 
-/* TODO:
 AJG_SYNTH_TEST_UNIT(magic variables) {
-    // std::cout << std::endl << string_template_type("<!--#echo var='DATE_LOCAL' -->").render_to_string(context) << std::endl;
-}}}*/
+    context.snapshot(traits_type::to_time(traits_type::to_date(2002, 1, 10), traits_type::to_duration(1, 2, 3)));
+    string_template_type const t("<!--#config timefmt='%Y-%m-%d %H:%M:%S' -->"
+        "<!--#echo var='DATE_GMT' --> <!--#echo var='DATE_LOCAL' -->");
+    MUST_EQUAL(t.render_to_string(context), "2002-01-10 01:02:03 2002-01-10 01:02:03");
+}}}
 
 
 AJG_SYNTH_TEST_UNIT(multiple config_tag attributes) {
@@ -247,6 +320,13 @@ AJG_SYNTH_TEST_UNIT(fsize_tag abbrev) {
     MUST_EQUAL(t.render_to_string(context), "1.3 KB");
 }}}
 
+AJG_SYNTH_TEST_UNIT(fsize_tag cached) {
+    options.caching = s::caching_mask(s::caching_files | s::caching_per_process);
+    string_template_type const t("<!--#fsize file='tests/templates/ssi/1338' --> "
+                                 "<!--#fsize file='tests/templates/ssi/1338' -->", options);
+    MUST_EQUAL(t.render_to_string(context), "1338 1338");
+}}}
+
 AJG_SYNTH_TEST_UNIT(flastmod_tag) {
     string_template_type const t("<!--#flastmod file='tests/templates/ssi/example.shtml' -->");
     MUST_EQUAL(t.render_to_string(context), traits_type::format_time("%A, %d-%b-%Y %H:%M:%S %Z",
@@ -282,3 +362,62 @@ AJG_SYNTH_TEST_UNIT(exec_tag) {
     string_template_type const t("<!--#exec cmd='" + command + " \"tests/templates/ssi\"' -->");
     MUST_NOT_EQUAL(t.render_to_string(context).find("example.shtml"), string_type::npos);
 }}}
+
+AJG_SYNTH_TEST_UNIT(exec_tag with limits) {
+    options_type limited;
+    limited.exec_ttl         = 60;
+    limited.exec_timeout     = 5;
+    limited.exec_concurrency = 1;
+    string_template_type const t("<!--#exec cmd='echo A' -->-<!--#exec cmd='echo B' -->", limited);
+    MUST_EQUAL(t.render_to_string(context), "A\n-B\n");
+    MUST_EQUAL(t.render_to_string(context), "A\n-B\n");
+}}}
+
+AJG_SYNTH_TEST_UNIT(exec_tag ahead) {
+    // Each command waits for the other to start, which only happens if they run at once; if they
+    // didn't, the first would time out instead.
+    scratch_directory const scratch;
+    options_type ahead;
+    ahead.exec_ahead   = true;
+    ahead.exec_timeout = 30;
+    string_template_type const t(
+        "<!--#exec cmd='touch " + scratch.path + "/a; until [ -e " + scratch.path + "/b ]; do sleep 0.05; done; echo A' -->-"
+        "<!--#exec cmd='touch " + scratch.path + "/b; until [ -e " + scratch.path + "/a ]; do sleep 0.05; done; echo B' -->", ahead);
+    MUST_EQUAL(t.render_to_string(context), "A\n-B\n");
+}}}
+
+AJG_SYNTH_TEST_UNIT(exec_tag with timeout) {
+    options_type limited;
+    limited.exec_timeout = 1;
+    string_template_type const t("<!--#exec cmd='sleep 5' -->", limited);
+    MUST_EQUAL(t.render_to_string(context), "[an error occurred while processing this directive]");
+}}}
+
+AJG_SYNTH_TEST_UNIT(exec_tag with timeout after output) {
+    options_type limited;
+    limited.exec_timeout = 1;
+    string_template_type const t("<!--#exec cmd='echo A; exec >&-; sleep 60' -->", limited);
+    std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+    MUST_EQUAL(t.render_to_string(context), "[an error occurred while processing this directive]");
+    MUST(std::chrono::steady_clock::now() - start < std::chrono::seconds(30)); // Not waited out.
+}}}
+
+AJG_SYNTH_TEST_UNIT(exec_tag ahead with timeout) {
+    options_type limited;
+    limited.exec_ahead   = true;
+    limited.exec_timeout = 1;
+    string_template_type const t("<!--#exec cmd='sleep 60' --><!--#exec cmd='sleep 60' -->", limited);
+    std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+    MUST_EQUAL(t.render_to_string(context), "[an error occurred while processing this directive]"
+                                            "[an error occurred while processing this directive]");
+    MUST(std::chrono::steady_clock::now() - start < std::chrono::seconds(30)); // Not waited out.
+}}}
+
+AJG_SYNTH_TEST_UNIT(exec_tag with timeout in a subshell) {
+    scratch_directory const scratch;
+    options_type limited;
+    limited.exec_timeout = 1;
+    string_template_type const t("<!--#exec cmd='(sleep 60; touch " + scratch.path + "/marker); true' -->", limited);
+    MUST_EQUAL(t.render_to_string(context), "[an error occurred while processing this directive]");
+    MUST_EQUAL(scratch.processes(), 0u); // The subshell went down with the shell.
+}}}
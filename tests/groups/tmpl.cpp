@@ -190,6 +190,11 @@ AJG_SYNTH_TEST_UNIT(loop __counter__ variable) {
     MUST_EQUAL(t.render_to_string(context), "1 2 3 ");
 }}}
 
+AJG_SYNTH_TEST_UNIT(loop variable scoping) {
+    string_template_type t("<TMPL_LOOP friends><TMPL_VAR foo>|<TMPL_VAR __counter__>|<TMPL_VAR NAME> </TMPL_LOOP><TMPL_VAR foo>");
+    MUST_EQUAL(t.render_to_string(context), "|1|joe |2|bob |3|lou A");
+}}}
+
 AJG_SYNTH_TEST_UNIT(file template) {
     path_template_type t("tests/templates/tmpl/variables.tmpl");
     MUST_EQUAL(t.render_to_string(context), "foo: A\nbar: B\nqux: C\n");
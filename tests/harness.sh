@@ -6,10 +6,20 @@
 function main {
     expect=$(echo -e -n 'foo: 1\nbar: 2\nqux: 3\n')
     actual=$(cat tests/templates/django/variables.tpl | ./synth -e django -c tests/data/variables.json)
+    check "$expect" "$actual"
 
-    if [[ "$expect" == "$actual" ]]
+    socket=$(mktemp -u /tmp/synth.XXXXXX)
+    ./synth --serve="$socket" & server=$!
+    while [[ ! -S "$socket" ]]; do sleep 0.1; done
+    actual=$(cat tests/templates/django/variables.tpl | ./synth -e django -c tests/data/variables.json --connect="$socket")
+    kill "$server"; rm -f "$socket"
+    check "$expect" "$actual"
+}
+
+function check {
+    if [[ "$1" == "$2" ]]
     then echo -e 'Success';
-    else echo -e 'Failure\nExpect: `'"$expect"'`\nActual: `'"$actual"'`';
+    else echo -e 'Failure\nExpect: `'"$1"'`\nActual: `'"$2"'`';
     fi
 }
 
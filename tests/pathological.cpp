@@ -0,0 +1,121 @@
+//  (C) Copyright 2014 Alvaro J. Genial (http://alva.ro)
+//  Use, modification and distribution are subject to the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt).
+
+// Times parsing adversarial or malformed sources of growing size, with and without a parse budget;
+// without one, some take exponential time, while with one all of them should stay (roughly) linear.
+// Usage: pathological.out [step limit per character (default: 10)] [largest size (default: 64)]
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <utility>
+#include <exception>
+#include <functional>
+
+#include <ajg/synth/templates.hpp>
+#include <ajg/synth/adapters.hpp>
+#include <ajg/synth/engines/ssi.hpp>
+#include <ajg/synth/engines/tmpl.hpp>
+#include <ajg/synth/engines/django.hpp>
+
+namespace {
+
+namespace s = ajg::synth;
+
+typedef s::default_traits<char>                                                 traits_type;
+typedef std::function<std::string(std::size_t)>                                 generator_type;
+typedef std::pair<char const*, generator_type>                                  case_type;
+
+// Past this many seconds, larger sizes of the same case are skipped when there's no budget.
+double const patience = 1.0;
+
+std::string repeat(std::string const& s, std::size_t n) {
+    std::string result;
+    while (n--) result += s;
+    return result;
+}
+
+template <class Engine>
+double time_parse(std::string const& source, std::size_t const step_limit, std::string& outcome) {
+    typename Engine::options_type options;
+    options.parse_step_limit = step_limit;
+    std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+
+    try {
+        s::templates::string_template<Engine> const t(source, options);
+        outcome = "parsed";
+    }
+    catch (s::parsing_error const& e) {
+        std::string const what = e.what();
+        outcome = what.find("limit exceeded") == std::string::npos ? "rejected" : "over budget";
+    }
+    catch (std::exception const& e) {
+        outcome = e.what();
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <class Engine>
+void run(std::vector<case_type> const& cases, std::size_t const step_limit, std::size_t const largest) {
+    for (auto const& c : cases) {
+        bool patient = true;
+
+        for (std::size_t n = 4; n <= largest; n *= 2) {
+            std::string const source = c.second(n);
+            std::string outcome, budgeted_outcome;
+            double const budgeted = time_parse<Engine>(source, step_limit, budgeted_outcome);
+
+            if (patient) {
+                double const unbounded = time_parse<Engine>(source, 0, outcome);
+                patient = unbounded < patience;
+                std::printf("%-6s %-28s n=%-4u %10.6fs (%-8s) %10.6fs (%s)\n", Engine::name(), c.first,
+                    unsigned(n), unbounded, outcome.c_str(), budgeted, budgeted_outcome.c_str());
+            }
+            else {
+                std::printf("%-6s %-28s n=%-4u %11s (%-8s) %10.6fs (%s)\n", Engine::name(), c.first,
+                    unsigned(n), "-", "skipped", budgeted, budgeted_outcome.c_str());
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int const argc, char const *const argv[]) {
+    std::size_t const step_limit = argc > 1 ? std::strtoul(argv[1], 0, 10) : 10;
+    std::size_t const largest    = argc > 2 ? std::strtoul(argv[2], 0, 10) : 64;
+
+    std::printf("%-6s %-28s %-6s %22s %22s\n", "engine", "case", "size", "unbounded", "budgeted");
+
+    run<s::engines::django::engine<traits_type> >(
+        { case_type("unclosed for tags",        [](std::size_t n) { return repeat("{% for x in y %}", n); })
+        , case_type("unclosed if tags",         [](std::size_t n) { return repeat("{% if x %}", n); })
+        , case_type("unclosed block tags",      [](std::size_t n) { return repeat("{% block a %}", n); })
+        , case_type("unclosed filter tags",     [](std::size_t n) { return repeat("{% filter upper %}", n); })
+        , case_type("mismatched end tags",      [](std::size_t n) { return repeat("{% if x %}a", n) + repeat("{% endfor %}", n); })
+        , case_type("unclosed parentheses",     [](std::size_t n) { return "{{ " + repeat("(", n) + "x }}"; })
+        , case_type("unterminated operators",   [](std::size_t n) { return "{% if " + repeat("a and (", n) + " %}"; })
+        , case_type("unclosed subscripts",      [](std::size_t n) { return "{{ x" + repeat("[x", n) + " }}"; })
+        , case_type("dangling filter arguments",[](std::size_t n) { return "{{ x" + repeat("|f:(", n) + " }}"; })
+        , case_type("unclosed variables",       [](std::size_t n) { return repeat("{{ ", n); })
+        , case_type("unclosed for tags and text",[](std::size_t n) { return repeat("{% for x in y %}", 8) + std::string(256 * n, 'a'); })
+        , case_type("unclosed if tags with text",[](std::size_t n) { return repeat("{% if x %}" + std::string(64, 'a'), n); })
+        , case_type("unclosed tags and a string",[](std::size_t n) { return repeat("{% if x %}", 8) + "{{ '" + std::string(256 * n, 'a'); })
+        }, step_limit, largest);
+
+    run<s::engines::ssi::engine<traits_type> >(
+        { case_type("unclosed if directives",   [](std::size_t n) { return repeat("<!--#if expr=\"x\" -->", n); })
+        , case_type("unterminated directives",  [](std::size_t n) { return repeat("<!--#echo var=\"x\" ", n); })
+        }, step_limit, largest);
+
+    run<s::engines::tmpl::engine<traits_type> >(
+        { case_type("unclosed if tags",         [](std::size_t n) { return repeat("<TMPL_IF x>", n); })
+        , case_type("unclosed loop tags",       [](std::size_t n) { return repeat("<TMPL_LOOP x>", n); })
+        }, step_limit, largest);
+
+    return EXIT_SUCCESS;
+}